@@ -3,29 +3,60 @@
 #include <inttypes.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#if !defined(_WIN32) && !defined(__DJGPP__)
+#define ARGLINK_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define ARGLINK_HAVE_WATCH 1
+#include <errno.h>
+#include <poll.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#if defined(__linux__)
+#include <sys/inotify.h>
+#endif
+#endif
+#if defined(_WIN32)
+#define ARGLINK_HAVE_THREADS 1
+#include <windows.h>
+#elif !defined(__DJGPP__)
+#define ARGLINK_HAVE_THREADS 1
+#include <pthread.h>
+#endif
 
 #define STRINGIZE_DETAIL(x) #x
 #define STRINGIZE(x) STRINGIZE_DETAIL(x)
 
 typedef struct LinkData {
-	char* Name;
+	const char* Name;
 	char* Origin;
 	int32_t Value;
+	uint64_t Hash;         // Of Name, kept for incremental links
+	uint32_t Definitions;  // Publics defining Name, duplicates included
 } LinkData;
 
+// An operation waiting on the stack while an expression is compiled
 typedef struct Calculation {
-	int32_t Deep;
-	int32_t Priority;
+	int32_t Rank;      // Deep * 4 + priority
 	int32_t Operation;
-	int32_t Value;
 } Calculation;
 
+// Ranks strictly increase up the stack: one entry per rank (8 deeps of 4 priorities) and the initial value
+#define CALCULATION_STACK 33
+
 typedef enum {
 	Success = 0,
-	BadCLIUsage = 64
+	BadCLIUsage = 64,
+	BadInputData = 65
 } BSDExitCodes;
 
 typedef enum {
@@ -38,13 +69,33 @@ typedef enum {
 uint8_t s_ioBuffersKiB = 10;
 char* s_defaultExtension = ".SOB";
 uint16_t s_stringHashSize = 256;
+uint8_t s_stringHashLoad = HT_DEFAULT_LOAD;
+uint8_t s_jobs = 1;
 uint8_t s_memoryMiB = 2;
 uint8_t s_romType = 0x7D;
 
 bool s_verbose; // = false;
+bool s_revalidateExternals; // = false;
+bool s_robinHood; // = false;
 char* s_directoryPrefix = "";
 
 #pragma mark - Utility methods
+#ifdef ARGLINK_HAVE_WATCH
+jmp_buf s_linkRecovery;
+bool s_linkRecoveryArmed; // = false; set by --watch while it links
+#endif
+
+// Link errors end the process, except under --watch, where they only end the link
+void LinkExit(int code)
+{
+#ifdef ARGLINK_HAVE_WATCH
+	if (s_linkRecoveryArmed) {
+		longjmp(s_linkRecovery, code);
+	}
+#endif
+	exit(code);
+}
+
 void OutputLogo()
 {
 	puts("ArgLink Re-Rewrite\t\t\t(c) 2025 Repzilon\n"
@@ -63,17 +114,34 @@ void OutputUsage()
 "\n"
 "** Available Options are:\n"
 "** -B<kib>\t- Set file input/output buffers (0-31), default = 10 KiB.\n"
-"** -C\t\t- Duplicate public warnings on.\n"
+"** -C\t\t- Duplicate public and overlapping relocation warnings on.\n"
 "** -E<.ext>\t- Change default file extension, default = '.SOB'.\n"
-"** -H<size>\t- String hash initial capacity, default = 256.\n"
+"** -H<size>\t- String hash initial capacity, default = parsed publics at the -K load.\n"
+"** -L<size>\t- Display used ROM layout (size is in KiB).\n"
 "** -O<romfile>\t- Output a ROM file.\n"
+"** -R\t\t- Display ROM block information.\n"
 "** -S\t\t- Display all public symbols.\n"
 "** -W<prefix>\t- Set prefix (Work directory) for object files.\n"
+"** -Z\t\t- Generate a debugger MAP file, named after the ROM file.\n"
 "\n"
 "** Re-rewrite Added Options are:\n"
+"** -G\t\t- Use Robin Hood probing for the string hash.\n"
+"** -J<jobs>\t- Load and link object files with n worker threads (1-64), default = 1.\n"
+"** -K<load>\t- String hash maximum load (25-95), default = 75 percent.\n"
 "** -Q\t\t- Turn off banner on startup.\n"
+"** -U\t\t- Check size and date of cached external files on each use.\n"
 "** -V\t\t- Turn on LuigiBlood's ARGLINK_REWRITE output to std. error.\n"
 "** -X<file>\t- Export public symbols to a text file, one per line\n"
+"** --free-map=<file>\t- Export a bitmap of free ROM bytes, one bit per byte, low bit first.\n"
+"** --incremental=<file>\t- Relink only changed objects, keeping link state in file.\n"
+"** --load-snapshot=<file>\t- Link from a snapshot instead of object files.\n"
+"** --stats=<file>\t- Export time and I/O counters of each link phase as JSON.\n"
+"** --save-snapshot=<file>\t- Save objects and symbols in a snapshot after step 2.\n"
+"** --verify-full\t- Check an incremental link against a full link.\n"
+"** --lookup=<file>\t- Look up names, @addresses and @low-high ranges in a symbol database.\n"
+"** --symbol-db=<file>\t- Export public symbols to a binary database sorted by name and address.\n"
+"** --watch\t- Stay resident and relink whenever an object or external file changes, on one job.\n"
+"** --watch-socket=<file>\t- With --watch, also relink on each connection to this socket.\n"
 "\n"
 "Ignored Options are:\n"
 "** -A1\t\t- Download to ADS SuperChild1 hardware.\n"
@@ -86,63 +154,452 @@ void OutputUsage()
 "\n"
 "** Unimplemented Options are:\n"
 "** -I\t\t- Display file information while loading.\n"
-"** -L<size>\t- Display used ROM layout (size is in KiB).\n"
 "** -M<size>\t- Memory size, default = 2 (mebibytes).\n"
-"** -R\t\t- Display ROM block information.\n"
 "** -T<type>\t- Set ROM type (in hex), default = 0x7D.\n"
-"** -Z\t\t- Generate a debugger MAP file.\n"
 );
 }
 
-char* GetNameChars(FILE* fileSob, size_t* nametempCount)
+#pragma mark - Instrumentation
+// --stats=<file>: wall and CPU time of each phase of main, I/O counters and symbol table
+// statistics, as JSON. The checking link of --verify-full adds to the phases it goes through. Counters are only touched when the report was asked for; table and
+// relocation figures are read from what the link holds anyway once a phase ends.
+typedef enum {
+	PhaseConstruct = 0, // ROM image fill
+	PhaseParse = 1,     // Reading and decoding objects (or a snapshot), reuse of incremental records
+	PhaseExternals = 2, // Step 1: sections and external files copied into the ROM
+	PhasePublics = 3,   // Step 2: publics merged into the symbol table
+	PhaseResolve = 4,   // Layout, -S, symbol database, relocations resolved and compiled, snapshot
+	PhaseImage = 5,     // Step 3: relocations evaluated and patched
+	PhaseExport = 6,    // ROM, -X, MAP, free map, -R and -L reports, incremental state
+	PhaseCount = 7
+} LinkPhase;
+
+typedef struct IoCounters {
+	uint64_t BytesRead;
+	uint64_t BytesWritten;
+	uint64_t Opens;
+	uint64_t Maps;
+	uint64_t Seeks;
+	uint64_t Reads;
+	uint64_t Writes;
+} IoCounters;
+
+typedef struct LinkStats {
+	LinkPhase Current;
+	double PhaseWall;
+	double PhaseCpu;
+	IoCounters PhaseIo;   // Counters when the current phase began
+	IoCounters Io;        // Updated by reader threads too
+	double WallSeconds[PhaseCount];
+	double CpuSeconds[PhaseCount];
+	IoCounters PhaseTotals[PhaseCount];
+	uint64_t SymbolsInserted;
+	uint64_t RelocationsApplied;
+	ht_stats Table;
+} LinkStats;
+
+LinkStats* s_stats; // = NULL, no report
+
+#if defined(_WIN32)
+#define StatsAdd(counter, amount) InterlockedExchangeAdd64((volatile LONG64*)&(counter), (LONG64)(amount))
+#elif defined(ARGLINK_HAVE_THREADS)
+#define StatsAdd(counter, amount) __atomic_fetch_add(&(counter), (uint64_t)(amount), __ATOMIC_RELAXED)
+#else
+#define StatsAdd(counter, amount) ((counter) += (uint64_t)(amount))
+#endif
+
+void StatsWrote(size_t bytes, uint64_t calls)
+{
+	if (s_stats != NULL) {
+		StatsAdd(s_stats->Io.BytesWritten, bytes);
+		StatsAdd(s_stats->Io.Writes, calls);
+	}
+}
+
+double WallSeconds(void)
+{
+#if defined(_WIN32)
+	LARGE_INTEGER frequency, now;
+	QueryPerformanceFrequency(&frequency); QueryPerformanceCounter(&now);
+	return (double)now.QuadPart / (double)frequency.QuadPart;
+#elif !defined(__DJGPP__)
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+#else
+	return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+// Ends the current phase, if any, and starts the next one (PhaseCount starts none)
+void StatsPhase(LinkPhase next)
+{
+	if (s_stats == NULL) {
+		return;
+	}
+	double wall = WallSeconds();
+	double cpu = (double)clock() / CLOCKS_PER_SEC;
+	IoCounters io = s_stats->Io;
+	if (s_stats->Current < PhaseCount) {
+		LinkPhase current = s_stats->Current;
+		IoCounters* totals = &s_stats->PhaseTotals[current];
+		s_stats->WallSeconds[current] += wall - s_stats->PhaseWall;
+		s_stats->CpuSeconds[current] += cpu - s_stats->PhaseCpu;
+		totals->BytesRead += io.BytesRead - s_stats->PhaseIo.BytesRead;
+		totals->BytesWritten += io.BytesWritten - s_stats->PhaseIo.BytesWritten;
+		totals->Opens += io.Opens - s_stats->PhaseIo.Opens;
+		totals->Maps += io.Maps - s_stats->PhaseIo.Maps;
+		totals->Seeks += io.Seeks - s_stats->PhaseIo.Seeks;
+		totals->Reads += io.Reads - s_stats->PhaseIo.Reads;
+		totals->Writes += io.Writes - s_stats->PhaseIo.Writes;
+	}
+	s_stats->Current = next;
+	s_stats->PhaseWall = wall;
+	s_stats->PhaseCpu = cpu;
+	s_stats->PhaseIo = io;
+}
+
+void StatsBegin(void)
+{
+	s_stats = (LinkStats*)calloc(1, sizeof(LinkStats)); if (s_stats == NULL) { puts("ArgLink error: cannot allocate for s_stats of type LinkStats*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	s_stats->Current = PhaseCount;
+	StatsPhase(PhaseConstruct);
+}
+
+void SaveLinkStats(const char* path)
+{
+	static const char* const phaseNames[PhaseCount] = { "construct", "parse", "externals", "publics", "resolve", "image", "export" };
+	StatsPhase(PhaseCount);
+	FILE* fileStats = fopen(path, "wb"); if (fileStats == NULL) { printf("ArgLink error: cannot open %s in Write mode, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(73); }
+	double wall = 0, cpu = 0;
+	fprintf(fileStats, "{\n  \"jobs\": %u,\n  \"phases\": [\n", (unsigned)s_jobs);
+	for (int32_t p = 0; p < PhaseCount; p++) {
+		const IoCounters* io = &s_stats->PhaseTotals[p];
+		fprintf(fileStats, "    { \"name\": \"%s\", \"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"bytes_read\": %" PRIu64 ", \"bytes_written\": %" PRIu64
+			", \"opens\": %" PRIu64 ", \"maps\": %" PRIu64 ", \"seeks\": %" PRIu64 ", \"reads\": %" PRIu64 ", \"writes\": %" PRIu64 " }%s\n",
+			phaseNames[p], s_stats->WallSeconds[p] * 1000, s_stats->CpuSeconds[p] * 1000, io->BytesRead, io->BytesWritten,
+			io->Opens, io->Maps, io->Seeks, io->Reads, io->Writes, (p + 1 < PhaseCount) ? "," : "");
+		wall += s_stats->WallSeconds[p];
+		cpu += s_stats->CpuSeconds[p];
+	}
+	const ht_stats* table = &s_stats->Table;
+	fprintf(fileStats, "  ],\n  \"wall_ms\": %.3f,\n  \"cpu_ms\": %.3f,\n  \"symbols_inserted\": %" PRIu64 ",\n  \"relocations_applied\": %" PRIu64 ",\n",
+		wall * 1000, cpu * 1000, s_stats->SymbolsInserted, s_stats->RelocationsApplied);
+	fprintf(fileStats, "  \"hash_table\": { \"capacity\": %" PRIuPTR ", \"length\": %" PRIuPTR ", \"total_probes\": %" PRIuPTR ", \"average_probes\": %.3f, \"max_probes\": %" PRIuPTR " }\n}\n",
+		table->capacity, table->length, table->total_probes, (table->length > 0) ? (double)table->total_probes / (double)table->length : 0.0, table->max_probes);
+	if (fclose(fileStats) != 0) { printf("ArgLink error: writing %s failed, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(74); }
+	free(s_stats);
+	s_stats = NULL;
+}
+
+#pragma mark - SOB reader
+// A whole SOB (or external) file held in memory (mapped when the host has mmap), parsed with a cursor
+typedef struct SobReader {
+	const uint8_t* Bytes;
+	size_t Size;
+	size_t Position;
+	bool IsMapped; // Otherwise Bytes was slurped in a heap block
+	int64_t ModifiedTime; // When opened, see ModifiedNanoseconds
+	uint64_t FileId;      // Inode of a mapped file
+} SobReader;
+
+// Nanoseconds where the host keeps them, so quick successive edits are told apart
+int64_t ModifiedNanoseconds(const struct stat* info)
+{
+#if defined(__APPLE__)
+	return (int64_t)info->st_mtimespec.tv_sec * 1000000000 + info->st_mtimespec.tv_nsec;
+#elif defined(ARGLINK_HAVE_MMAP)
+	return (int64_t)info->st_mtim.tv_sec * 1000000000 + info->st_mtim.tv_nsec;
+#else
+	return (int64_t)info->st_mtime * 1000000000;
+#endif
+}
+
+SobReader* SobReaderOpen(const char* path)
+{
+	// Opened first, so a missing file leaves nothing allocated behind for --watch
+#ifdef ARGLINK_HAVE_MMAP
+	int fd = open(path, O_RDONLY); if (fd < 0) { printf("ArgLink error: cannot open %s in Read mode, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(66); }
+	SobReader* reader = (SobReader*)calloc(1, sizeof(SobReader)); if (reader == NULL) { puts("ArgLink error: cannot allocate for reader of type SobReader*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	struct stat info; if (fstat(fd, &info) != 0) { printf("ArgLink error: cannot get size of %s, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(74); }
+	reader->Size = (size_t)info.st_size;
+	reader->ModifiedTime = ModifiedNanoseconds(&info);
+	reader->FileId = (uint64_t)info.st_ino;
+	if (reader->Size > 0) {
+		void* mapping = mmap(NULL, reader->Size, PROT_READ, MAP_PRIVATE, fd, 0); if (mapping == MAP_FAILED) { printf("ArgLink error: cannot map %s in memory, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(74); }
+		reader->Bytes = (const uint8_t*)mapping;
+		reader->IsMapped = true;
+	}
+	close(fd);
+	if (s_stats != NULL) {
+		StatsAdd(s_stats->Io.Opens, 1);
+		StatsAdd(s_stats->Io.Maps, (reader->Size > 0) ? 1 : 0);
+		StatsAdd(s_stats->Io.BytesRead, reader->Size);
+	}
+#else
+	FILE* fileIn = fopen(path, "rb"); if (fileIn == NULL) { printf("ArgLink error: cannot open %s in Read mode, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(66); }; size_t fileInZone = (size_t)(s_ioBuffersKiB * 1024); char* fileInBuffer = (fileInZone > 0) ? (char*)calloc(fileInZone, sizeof(char)) : NULL; setvbuf(fileIn, fileInBuffer, fileInBuffer ? _IOFBF : _IONBF, fileInZone);
+	fseek(fileIn, 0, SEEK_END); long fileSize = ftell(fileIn); fseek(fileIn, 0, SEEK_SET);
+	if (fileSize < 0) { printf("ArgLink error: cannot get size of %s, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(74); }
+	SobReader* reader = (SobReader*)calloc(1, sizeof(SobReader)); if (reader == NULL) { puts("ArgLink error: cannot allocate for reader of type SobReader*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	reader->Size = (size_t)fileSize;
+	uint8_t* slurped = (uint8_t*)malloc(reader->Size + 1); if (slurped == NULL) { puts("ArgLink error: cannot allocate for slurped of type uint8_t*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	if (fread(slurped, sizeof(uint8_t), reader->Size, fileIn) != reader->Size) { printf("ArgLink error: reading %s failed, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(74); }
+	reader->Bytes = slurped;
+	fclose(fileIn); free(fileInBuffer);
+	struct stat info;
+	reader->ModifiedTime = (stat(path, &info) == 0) ? ModifiedNanoseconds(&info) : 0;
+	if (s_stats != NULL) {
+		StatsAdd(s_stats->Io.Opens, 1);
+		StatsAdd(s_stats->Io.Seeks, 2);
+		StatsAdd(s_stats->Io.Reads, 1);
+		StatsAdd(s_stats->Io.BytesRead, reader->Size);
+	}
+#endif
+	return reader;
+}
+
+// Reading a mapped page past the end of its file faults, so a file truncated since it was
+// mapped (rewritten in place by an editor, say) is reported before it is read again. A file
+// replaced by another keeps its old mapping intact.
+void SobReaderRevalidate(const SobReader* reader, const char* path)
+{
+#ifdef ARGLINK_HAVE_MMAP
+	struct stat info;
+	if (reader->IsMapped && (stat(path, &info) == 0) && ((uint64_t)info.st_ino == reader->FileId) && ((size_t)info.st_size < reader->Size)) {
+		printf("ArgLink error: %s was truncated while linking, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(74);
+	}
+#else
+	(void)reader; (void)path;
+#endif
+}
+
+void SobReaderClose(SobReader* reader)
+{
+#ifdef ARGLINK_HAVE_MMAP
+	if (reader->IsMapped) {
+		munmap((void*)reader->Bytes, reader->Size);
+	}
+#else
+	free((void*)reader->Bytes);
+#endif
+	free(reader);
+}
+
+// Same contract as fgetc: next byte, or EOF past the end of the file
+int SobGetc(SobReader* reader)
+{
+	return (reader->Position < reader->Size) ? reader->Bytes[reader->Position++] : EOF;
+}
+
+uint8_t SobReadByte(SobReader* reader)
+{
+	if (reader->Position >= reader->Size) { puts("ArgLink error: reading byte from fileSob failed, source code line " STRINGIZE(__LINE__)); LinkExit(74); }
+	return reader->Bytes[reader->Position++];
+}
+
+// Returns a view of the NUL-terminated name at the cursor, which stays valid until the reader is closed
+const char* GetNameChars(SobReader* fileSob, size_t* nametempCount)
+{
+	const uint8_t* start = fileSob->Bytes + fileSob->Position;
+	const uint8_t* nul = (fileSob->Position < fileSob->Size) ? (const uint8_t*)memchr(start, 0, fileSob->Size - fileSob->Position) : NULL;
+	if (nul == NULL) { puts("ArgLink error: reading byte from fileSob failed, source code line " STRINGIZE(__LINE__)); LinkExit(74); }
+	*nametempCount = (size_t)(nul - start);
+	fileSob->Position += *nametempCount + 1;
+	return (const char*)start;
+}
+
+const char* GetName(SobReader* fileSob)
+{
+	size_t count; return GetNameChars(fileSob, &count);
+}
+
+bool SOBJWasRead(SobReader* fileSob)
+{
+	return SobGetc(fileSob) == 0x53 //S
+		&& SobGetc(fileSob) == 0x4F //O
+		&& SobGetc(fileSob) == 0x42 //B
+		&& SobGetc(fileSob) == 0x4A; //J
+}
+
+int32_t ReadLEInt32(SobReader* fileSob)
+{
+	if (fileSob->Size - fileSob->Position < 4 || fileSob->Position > fileSob->Size) { puts("ArgLink error: reading integer from fileSob failed, source code line " STRINGIZE(__LINE__)); LinkExit(74); }
+	const uint8_t* at = fileSob->Bytes + fileSob->Position;
+	fileSob->Position += 4;
+	return (int32_t)((uint32_t)at[0] | ((uint32_t)at[1] << 8) | ((uint32_t)at[2] << 16) | ((uint32_t)at[3] << 24));
+}
+
+#pragma mark - ROM image
+// The whole ROM is built in memory by all linking phases, then written once
+#define ROM_FILL_SIZE 0x100000 // Filled with 0xFF before any section is copied
+
+typedef struct RomImage {
+	uint8_t* Bytes;
+	size_t Size;     // Highest offset written so far, like the end of the output file
+	size_t Capacity; // Allocated length of Bytes
+} RomImage;
+
+RomImage* RomImageCreate(size_t initialSize, uint8_t filler)
+{
+	RomImage* rom = (RomImage*)calloc(1, sizeof(RomImage)); if (rom == NULL) { puts("ArgLink error: cannot allocate for rom of type RomImage*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	rom->Bytes = (uint8_t*)malloc(initialSize); if (rom->Bytes == NULL) { puts("ArgLink error: cannot allocate ROM image bytes, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	memset(rom->Bytes, filler, initialSize);
+	rom->Size = initialSize;
+	rom->Capacity = initialSize;
+	return rom;
+}
+
+void RomImageDestroy(RomImage* rom)
+{
+	free(rom->Bytes); free(rom);
+}
+
+// Returns a pointer to size writable bytes at offset. Like seeking past the end of a file,
+// growing the image fills the gap with zeroes.
+uint8_t* RomImageAt(RomImage* rom, int64_t offset, size_t size)
 {
-	char* nametemp = NULL; *nametempCount = 0;
-	char check = 'A';
-	while (check != 0) {
-		{ int whatRead = fgetc(fileSob); if (whatRead == EOF) { puts("ArgLink error: reading byte from fileSob failed, source code line " STRINGIZE(__LINE__)); exit(74); } else { check = (char)whatRead; } };
-		if (check != 0) {
-			(*nametempCount)++; nametemp = (char*)realloc(nametemp, *nametempCount * sizeof(char));if (nametemp == NULL) { puts("ArgLink error: cannot grow list of char named nametemp, source code line " STRINGIZE(__LINE__)); exit(70); }; nametemp[*nametempCount - 1] = check;
+	if ((offset < 0) || ((uint64_t)offset + size > (uint64_t)SIZE_MAX / 2)) {
+		printf("ArgLink error: ROM offset %" PRId64 " is out of range, source code line " STRINGIZE(__LINE__) "\n", offset); LinkExit(65);
+	}
+
+	size_t end = (size_t)offset + size;
+	if (end > rom->Capacity) {
+		size_t newCapacity = rom->Capacity * 2;
+		if (newCapacity < end) {
+			newCapacity = end;
 		}
+		rom->Bytes = (uint8_t*)realloc(rom->Bytes, newCapacity); if (rom->Bytes == NULL) { puts("ArgLink error: cannot grow ROM image bytes, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+		rom->Capacity = newCapacity;
+	}
+	if (end > rom->Size) {
+		memset(rom->Bytes + rom->Size, 0, end - rom->Size);
+		rom->Size = end;
+	}
+	return rom->Bytes + offset;
+}
+
+void RomImageFlush(const RomImage* rom, FILE* destination)
+{
+	if (fwrite(rom->Bytes, sizeof(uint8_t), rom->Size, destination) != rom->Size) {
+		puts("ArgLink error: writing ROM image failed, source code line " STRINGIZE(__LINE__)); LinkExit(74);
+	}
+	StatsWrote(rom->Size, 1);
+}
+
+void RecopyBytes(const uint8_t* source, size_t got, size_t size, RomImage* destination, int32_t offset)
+{
+	uint8_t* target = RomImageAt(destination, offset, size);
+	memcpy(target, source, got);
+	// A truncated section leaves zeroes, as the original zero-filled transfer buffer did
+	if (got < size) {
+		memset(target + got, 0, size - got);
 	}
+}
 
-	return nametemp;
+// Returns how many of the next size bytes the file really has
+size_t SobAvailable(const SobReader* source, size_t size)
+{
+	size_t got = (source->Position < source->Size) ? source->Size - source->Position : 0;
+	return (got > size) ? size : got;
 }
 
-char* GetName(FILE* fileSob)
+#pragma mark - External file cache
+// External files referenced by several sections are mapped once per link, keyed by normalized path.
+// An incremental link keeps the entries, with the size and time each file had when read.
+typedef struct ExternalFile {
+	SobReader* Contents;   // NULL once released, and always on hosts without mmap
+	int64_t FileSize;
+	int64_t ModifiedTime;
+} ExternalFile;
+
+ExternalFile* GetExternalEntry(ht* externals, const char* filepath)
 {
-	size_t Count; char* functionResult = GetNameChars(fileSob, &Count); char* resultString = (char*)calloc(Count + 1, sizeof(char)); memmove(resultString, functionResult, Count); return resultString;
+	ExternalFile* cached = (ExternalFile*)ht_get(externals, filepath);
+	if (cached == NULL) {
+		cached = (ExternalFile*)calloc(1, sizeof(ExternalFile)); if (cached == NULL) { puts("ArgLink error: cannot allocate for cached of type ExternalFile*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+		ht_set(externals, filepath, cached);
+	}
+	return cached;
 }
 
-bool SOBJWasRead(FILE* fileSob)
+#ifdef ARGLINK_HAVE_MMAP
+SobReader* GetExternalFile(ht* externals, const char* filepath)
 {
-	return fgetc(fileSob) == 0x53 //S
-		&& fgetc(fileSob) == 0x4F //O
-		&& fgetc(fileSob) == 0x42 //B
-		&& fgetc(fileSob) == 0x4A; //J
+	struct stat info;
+	ExternalFile* cached = GetExternalEntry(externals, filepath);
+	if (cached->Contents != NULL) {
+		if (!s_revalidateExternals) {
+			return cached->Contents;
+		} else if ((stat(filepath, &info) == 0) && ((int64_t)info.st_size == cached->FileSize) &&
+			(ModifiedNanoseconds(&info) == cached->ModifiedTime)) {
+			return cached->Contents;
+		}
+		SobReaderClose(cached->Contents);
+	}
+
+	cached->Contents = SobReaderOpen(filepath);
+	cached->FileSize = (int64_t)cached->Contents->Size;
+	cached->ModifiedTime = cached->Contents->ModifiedTime;
+	return cached->Contents;
 }
+#endif
 
-Calculation* InitCalculation(int32_t deep, int32_t priority, int32_t operation, int32_t value)
+// Copies up to size bytes of the external file, from skip on, to target and returns how many it
+// had. Without mmap they are read straight into target through the -B buffer, not slurped first.
+size_t CopyExternal(ht* externals, const char* filepath, size_t skip, uint8_t* target, size_t size)
 {
-	Calculation* calctemp = (Calculation*)calloc(1, sizeof(Calculation)); if (calctemp == NULL) { puts("ArgLink error: cannot allocate for calctemp of type Calculation*, source code line " STRINGIZE(__LINE__)); exit(70); }
-	calctemp->Deep = deep;
-	calctemp->Priority = priority;
-	calctemp->Operation = operation;
-	calctemp->Value = value;
-	return calctemp;
+#ifdef ARGLINK_HAVE_MMAP
+	SobReader* fileExt = GetExternalFile(externals, filepath);
+	size_t got = (fileExt->Size > skip) ? fileExt->Size - skip : 0;
+	if (got > size) {
+		got = size;
+	}
+	if (got > 0) {
+		memcpy(target, fileExt->Bytes + skip, got);
+	}
+#else
+	FILE* fileExt = fopen(filepath, "rb"); if (fileExt == NULL) { printf("ArgLink error: cannot open %s in Read mode, source code line " STRINGIZE(__LINE__) "\n", filepath); LinkExit(66); }; size_t fileExtZone = (size_t)(s_ioBuffersKiB * 1024); char* fileExtBuffer = (fileExtZone > 0) ? (char*)calloc(fileExtZone, sizeof(char)) : NULL; setvbuf(fileExt, fileExtBuffer, fileExtBuffer ? _IOFBF : _IONBF, fileExtZone);
+	size_t got = 0;
+	if ((skip == 0) || (fseek(fileExt, (long)skip, SEEK_SET) == 0)) {
+		got = fread(target, sizeof(uint8_t), size, fileExt);
+	}
+	if (ferror(fileExt)) { printf("ArgLink error: reading %s failed, source code line " STRINGIZE(__LINE__) "\n", filepath); LinkExit(74); }
+	fclose(fileExt); free(fileExtBuffer);
+	ExternalFile* cached = GetExternalEntry(externals, filepath);
+	struct stat info;
+	if (stat(filepath, &info) == 0) {
+		cached->FileSize = (int64_t)info.st_size;
+		cached->ModifiedTime = ModifiedNanoseconds(&info);
+	}
+	if (s_stats != NULL) {
+		StatsAdd(s_stats->Io.Opens, 1);
+		StatsAdd(s_stats->Io.Seeks, (skip > 0) ? 1 : 0);
+		StatsAdd(s_stats->Io.Reads, 1);
+		StatsAdd(s_stats->Io.BytesRead, got);
+	}
+#endif
+	return got;
 }
 
-int32_t ReadLEInt32(FILE* fileSob)
+// Closes the files but keeps their sizes and times
+void ReleaseExternalFiles(ht* externals)
 {
-	return fgetc(fileSob) | (fgetc(fileSob) << 8) | (fgetc(fileSob) << 16) |
-		(fgetc(fileSob) << 24);
+	hti kvp = ht_iterator(externals); while (ht_next(&kvp)) {
+		ExternalFile* cached = (ExternalFile*)kvp.value;
+		if (cached->Contents != NULL) {
+			SobReaderClose(cached->Contents);
+			cached->Contents = NULL;
+		}
+	}
 }
 
-void Recopy(FILE* source, size_t size, FILE* destination, int32_t offset)
+void DestroyExternalFiles(ht* externals)
 {
-	uint8_t* buffer = (uint8_t*)calloc((size_t)size, sizeof(uint8_t)); if (buffer == NULL) { puts("ArgLink error: cannot allocate for buffer of type uint8_t*, source code line " STRINGIZE(__LINE__)); exit(70); }
-	fread(buffer, sizeof(uint8_t), size, source);
-	fseek(destination, offset, SEEK_SET);
-	fwrite(buffer, sizeof(uint8_t), size, destination);
+	ReleaseExternalFiles(externals);
+	hti kvp = ht_iterator(externals); while (ht_next(&kvp)) {
+		free(kvp.value);
+	}
+	ht_destroy(externals);
 }
 
 #pragma mark - Verbose output
@@ -281,6 +738,28 @@ bool IsIgnoredFlag(char flag, const char* argument)
 	return false;
 }
 
+// Long options have no single-letter form and are only accepted with --
+bool IsLongFlag(const char* name, const char* argument, bool* optionVariable)
+{
+	if ((strncmp(argument, "--", 2) == 0) && (strcmp(argument + 2, name) == 0)) {
+		*optionVariable = true;
+		return true;
+	}
+
+	return false;
+}
+
+bool IsLongStringFlag(const char* name, char* argument, char** value)
+{
+	size_t length = strlen(name);
+	if ((strncmp(argument, "--", 2) == 0) && (strncmp(argument + 2, name, length) == 0) && (argument[2 + length] == '=')) {
+		*value = argument + 3 + length;
+		return true;
+	}
+
+	return false;
+}
+
 char* ExtensionOf(const char* path)
 {
 	char* dot = strrchr(path, '.'); return (!dot || dot == path) ? NULL : dot;
@@ -293,7 +772,7 @@ char* AppendPrefixAndExtension(char* argSfxObjectFile)
 	if (((s_directoryPrefix == NULL) || (strlen(s_directoryPrefix) < 1))) {
 		if (((ext == NULL) || (strlen(ext) < 1))) {
 			char* corrected;
-			int nbytes = snprintf(NULL, 0, "%s%s", argSfxObjectFile, s_defaultExtension); if (nbytes < 0) { puts("ArgLink error: cannot evaluate length with snprintf, source code line " STRINGIZE(__LINE__)); exit(70); } else { nbytes++; corrected = (char*)calloc((size_t)nbytes, sizeof(char)); if (corrected == NULL) { puts("ArgLink error: cannot allocate memory, source code line " STRINGIZE(__LINE__)); exit(70); } else { snprintf(corrected, (size_t)nbytes, "%s%s", argSfxObjectFile, s_defaultExtension); } }
+			int nbytes = snprintf(NULL, 0, "%s%s", argSfxObjectFile, s_defaultExtension); if (nbytes < 0) { puts("ArgLink error: cannot evaluate length with snprintf, source code line " STRINGIZE(__LINE__)); LinkExit(70); } else { nbytes++; corrected = (char*)calloc((size_t)nbytes, sizeof(char)); if (corrected == NULL) { puts("ArgLink error: cannot allocate memory, source code line " STRINGIZE(__LINE__)); LinkExit(70); } else { snprintf(corrected, (size_t)nbytes, "%s%s", argSfxObjectFile, s_defaultExtension); } }
 			return corrected;
 		} else {
 			return argSfxObjectFile;
@@ -301,272 +780,3625 @@ char* AppendPrefixAndExtension(char* argSfxObjectFile)
 	} else {
 		char* corrected;
 		if (((ext == NULL) || (strlen(ext) < 1))) {
-			int nbytes = snprintf(NULL, 0, "%s/%s%s", s_directoryPrefix, argSfxObjectFile, s_defaultExtension); if (nbytes < 0) { puts("ArgLink error: cannot evaluate length with snprintf, source code line " STRINGIZE(__LINE__)); exit(70); } else { nbytes++; corrected = (char*)calloc((size_t)nbytes, sizeof(char)); if (corrected == NULL) { puts("ArgLink error: cannot allocate memory, source code line " STRINGIZE(__LINE__)); exit(70); } else { snprintf(corrected, (size_t)nbytes, "%s/%s%s", s_directoryPrefix, argSfxObjectFile, s_defaultExtension); } }
+			int nbytes = snprintf(NULL, 0, "%s/%s%s", s_directoryPrefix, argSfxObjectFile, s_defaultExtension); if (nbytes < 0) { puts("ArgLink error: cannot evaluate length with snprintf, source code line " STRINGIZE(__LINE__)); LinkExit(70); } else { nbytes++; corrected = (char*)calloc((size_t)nbytes, sizeof(char)); if (corrected == NULL) { puts("ArgLink error: cannot allocate memory, source code line " STRINGIZE(__LINE__)); LinkExit(70); } else { snprintf(corrected, (size_t)nbytes, "%s/%s%s", s_directoryPrefix, argSfxObjectFile, s_defaultExtension); } }
 		} else {
-			int nbytes = snprintf(NULL, 0, "%s/%s", s_directoryPrefix, argSfxObjectFile); if (nbytes < 0) { puts("ArgLink error: cannot evaluate length with snprintf, source code line " STRINGIZE(__LINE__)); exit(70); } else { nbytes++; corrected = (char*)calloc((size_t)nbytes, sizeof(char)); if (corrected == NULL) { puts("ArgLink error: cannot allocate memory, source code line " STRINGIZE(__LINE__)); exit(70); } else { snprintf(corrected, (size_t)nbytes, "%s/%s", s_directoryPrefix, argSfxObjectFile); } }
+			int nbytes = snprintf(NULL, 0, "%s/%s", s_directoryPrefix, argSfxObjectFile); if (nbytes < 0) { puts("ArgLink error: cannot evaluate length with snprintf, source code line " STRINGIZE(__LINE__)); LinkExit(70); } else { nbytes++; corrected = (char*)calloc((size_t)nbytes, sizeof(char)); if (corrected == NULL) { puts("ArgLink error: cannot allocate memory, source code line " STRINGIZE(__LINE__)); LinkExit(70); } else { snprintf(corrected, (size_t)nbytes, "%s/%s", s_directoryPrefix, argSfxObjectFile); } }
 		}
 		return corrected;
 	}
 }
 
+#pragma mark - Worker threads
+typedef void (*WorkFunction)(void* context, int32_t index);
+
+// Indexes 0 to Count - 1 handed out one at a time to whichever thread is free
+typedef struct WorkQueue {
+	WorkFunction Work;
+	void* Context;
+	int32_t Count;
+	int32_t Next;
+#if defined(_WIN32)
+	CRITICAL_SECTION Lock;
+#elif defined(ARGLINK_HAVE_THREADS)
+	pthread_mutex_t Lock;
+#endif
+} WorkQueue;
+
+int32_t TakeWork(WorkQueue* queue)
+{
+	int32_t index;
+#if defined(_WIN32)
+	EnterCriticalSection(&queue->Lock);
+#elif defined(ARGLINK_HAVE_THREADS)
+	pthread_mutex_lock(&queue->Lock);
+#endif
+	index = (queue->Next < queue->Count) ? queue->Next++ : -1;
+#if defined(_WIN32)
+	LeaveCriticalSection(&queue->Lock);
+#elif defined(ARGLINK_HAVE_THREADS)
+	pthread_mutex_unlock(&queue->Lock);
+#endif
+	return index;
+}
+
+void DrainWorkQueue(WorkQueue* queue)
+{
+	for (int32_t index; (index = TakeWork(queue)) >= 0; ) {
+		queue->Work(queue->Context, index);
+	}
+}
+
+#if defined(_WIN32)
+DWORD WINAPI WorkerThread(LPVOID queue)
+{
+	DrainWorkQueue((WorkQueue*)queue);
+	return 0;
+}
+#elif defined(ARGLINK_HAVE_THREADS)
+void* WorkerThread(void* queue)
+{
+	DrainWorkQueue((WorkQueue*)queue);
+	return NULL;
+}
+#endif
+
+// Runs work for every index on up to jobs threads, the calling one included.
+// Hosts without threads (DJGPP) run everything on the calling thread.
+void RunOnWorkers(uint8_t jobs, int32_t count, WorkFunction work, void* context)
+{
+	WorkQueue queue;
+	queue.Work = work;
+	queue.Context = context;
+	queue.Count = count;
+	queue.Next = 0;
+#ifdef ARGLINK_HAVE_THREADS
+	int32_t extra = ((int32_t)jobs < count ? (int32_t)jobs : count) - 1;
+	if (extra > 0) {
+#if defined(_WIN32)
+		InitializeCriticalSection(&queue.Lock);
+		HANDLE* threads = (HANDLE*)calloc((size_t)extra, sizeof(HANDLE)); if (threads == NULL) { puts("ArgLink error: cannot allocate for threads of type HANDLE*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+		for (int32_t t = 0; t < extra; t++) {
+			threads[t] = CreateThread(NULL, 0, WorkerThread, &queue, 0, NULL); if (threads[t] == NULL) { puts("ArgLink error: cannot create worker thread, source code line " STRINGIZE(__LINE__)); LinkExit(71); }
+		}
+		DrainWorkQueue(&queue);
+		WaitForMultipleObjects((DWORD)extra, threads, TRUE, INFINITE);
+		for (int32_t t = 0; t < extra; t++) {
+			CloseHandle(threads[t]);
+		}
+		DeleteCriticalSection(&queue.Lock);
+#else
+		pthread_mutex_init(&queue.Lock, NULL);
+		pthread_t* threads = (pthread_t*)calloc((size_t)extra, sizeof(pthread_t)); if (threads == NULL) { puts("ArgLink error: cannot allocate for threads of type pthread_t*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+		for (int32_t t = 0; t < extra; t++) {
+			if (pthread_create(&threads[t], NULL, WorkerThread, &queue) != 0) { puts("ArgLink error: cannot create worker thread, source code line " STRINGIZE(__LINE__)); LinkExit(71); }
+		}
+		DrainWorkQueue(&queue);
+		for (int32_t t = 0; t < extra; t++) {
+			pthread_join(threads[t], NULL);
+		}
+		pthread_mutex_destroy(&queue.Lock);
+#endif
+		free(threads);
+		return;
+	}
+#else
+	(void)jobs;
+#endif
+	for (int32_t index = 0; index < count; index++) {
+		work(context, index);
+	}
+}
+
 #pragma mark - Linking phases
-void InputSobStepOne(int32_t i, FILE* fileOut, FILE* fileSob)
+// One operation of a relocation expression, as stored in the SOB file
+typedef struct RelocationTerm {
+	uint8_t Check1; // Deep, priority and symbol flag
+	uint8_t Operation;
+	int32_t Value;
+} RelocationTerm;
+
+// A relocation decoded during the first pass, so linking needs no further file I/O
+typedef struct Relocation {
+	const char* Name;      // Symbol giving the initial value
+	const char* Secondary; // Symbol used by flagged terms, or NULL to use Name
+	uint32_t Symbol;       // ID of Name, once resolved
+	uint32_t TermSymbol;   // ID of Secondary (or Name), once resolved
+	uint32_t Position;     // Where the record starts in its SOB file, for verbose output
+	int32_t Offset;
+	uint8_t Format;
+	uint32_t FirstTerm;    // Index into SobObject.Terms
+	uint32_t TermCount;
+	uint32_t Expression;   // ID of the compiled terms, once interned
+	uint32_t Result;       // Index of the memoized value of the expression for these symbols
+} Relocation;
+
+// The bytes a relocation writes, evaluated before they go into the ROM
+typedef struct Patch {
+	int64_t Start;
+	int32_t Value;
+	uint8_t Width;         // 0 when the format is unknown and nothing is written
+} Patch;
+
+// A section recorded while parsing an object, copied into the ROM when the object is merged
+typedef struct SectionWrite {
+	uint32_t Start;       // Where the header starts in the SOB file, for verbose output
+	int32_t Offset;
+	size_t Size;
+	int32_t Type;
+	const uint8_t* Data;  // Type 0: bytes in the SOB file
+	size_t DataSize;      // Type 0: less than Size when the file is truncated
+	char* ExternalPath;   // Type 1: normalized path of the external file
+} SectionWrite;
+
+// A public recorded while parsing an object, put in the symbol table when the object is merged
+typedef struct PublicDef {
+	const char* Name;     // View into the SOB file
+	size_t Length;
+	uint64_t Hash;
+	int32_t Value;
+	uint32_t Symbol;      // ID, once merged
+} PublicDef;
+
+// A loaded object file; its names are views into Contents, which stays open until linked.
+// Parsing fills everything but the symbol table and ROM, so objects can be parsed in parallel.
+typedef struct SobObject {
+	char* Path;
+	SobReader* Contents;
+	uint64_t FileSize;     // Size and time when opened, and content hash, for incremental links
+	int64_t ModifiedTime;
+	uint64_t Fingerprint;
+	bool IsSobj;
+	SectionWrite* Sections;
+	int32_t SectionCount;
+	PublicDef* Publics;
+	size_t PublicCount;
+	size_t PublicCapacity;
+	int64_t StartLink;
+	bool Linkable;         // Whether relocations follow the publics
+	Relocation* Relocations;
+	size_t RelocationCount;
+	size_t RelocationCapacity;
+	RelocationTerm* Terms;
+	size_t TermCount;
+	size_t TermCapacity;
+	Patch* Patches;        // One per relocation, filled by step 3
+} SobObject;
+
+// Publics get dense IDs in definition order; the index maps a name to its ID + 1
+typedef struct SymbolTable {
+	ht* Index;
+	LinkData* Symbols; // Indexed by symbol ID
+	size_t Count;
+	size_t Capacity;
+} SymbolTable;
+
+void* SymbolRef(uint32_t id)
+{
+	return (void*)((uintptr_t)id + 1);
+}
+
+uint32_t SymbolId(const void* ref)
+{
+	return (uint32_t)((uintptr_t)ref - 1);
+}
+
+SymbolTable* SymbolTableCreate(size_t initialCapacity, size_t symbolCapacity)
+{
+	SymbolTable* table = (SymbolTable*)calloc(1, sizeof(SymbolTable)); if (table == NULL) { puts("ArgLink error: cannot allocate for table of type SymbolTable*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	table->Index = ht_create_with(initialCapacity, s_robinHood ? HT_ROBIN_HOOD : HT_LINEAR, s_stringHashLoad);
+	table->Capacity = (symbolCapacity > 0) ? symbolCapacity : 1;
+	table->Symbols = (LinkData*)calloc(table->Capacity, sizeof(LinkData)); if (table->Symbols == NULL) { puts("ArgLink error: cannot allocate for table->Symbols of type LinkData*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	return table;
+}
+
+void SymbolTableDestroy(SymbolTable* table)
 {
-	int64_t start = ftell(fileSob);
-	int32_t offset = ReadLEInt32(fileSob);
-	size_t size = ReadLEInt32(fileSob);
-	int32_t type = fgetc(fileSob); if (type == EOF) { puts("ArgLink error: reading byte from fileSob failed, source code line " STRINGIZE(__LINE__)); exit(74); };
+	ht_destroy(table->Index); free(table->Symbols); free(table);
+}
 
-	LuigiFormat("%X: 0x%X /// Size: 0x%X / Offset 0x%X / Type %X", i,
-		start, size, offset, type);
+void InputSobStepOne(SectionWrite* section, SobReader* fileSob)
+{
+	section->Start = (uint32_t)fileSob->Position;
+	section->Offset = ReadLEInt32(fileSob);
+	section->Size = (size_t)(uint32_t)ReadLEInt32(fileSob);
+	section->Type = SobReadByte(fileSob);
 
-	if (type == 0) {
+	if (section->Type == 0) {
 		//Data
-		Recopy(fileSob, size, fileOut, offset);
-	} else if (type == 1) {
+		section->DataSize = SobAvailable(fileSob, section->Size);
+		section->Data = fileSob->Bytes + fileSob->Position;
+		fileSob->Position += section->DataSize;
+	} else if (section->Type == 1) {
 		//External File
-		if (fgetc(fileSob) == EOF) { puts("ArgLink error: reading byte from fileSob failed, source code line " STRINGIZE(__LINE__)); exit(74); };
-		if (fgetc(fileSob) == EOF) { puts("ArgLink error: reading byte from fileSob failed, source code line " STRINGIZE(__LINE__)); exit(74); };
+		SobReadByte(fileSob);
+		SobReadByte(fileSob);
 
 		//Get file path
-		char* filepath = GetName(fileSob);
+		size_t filepathCount; const char* filepathView = GetNameChars(fileSob, &filepathCount);
+		char* filepath = (char*)calloc(filepathCount + 1, sizeof(char)); if (filepath == NULL) { puts("ArgLink error: cannot allocate for filepath of type char*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }; memcpy(filepath, filepathView, filepathCount);
 		// POSIX requires / as directory separator, Windows and DJGPP tolerate it
 		for (char* current_pos; (current_pos = strchr(filepath, '\\')) != NULL; *current_pos = '/');
-		LuigiFormat("--Open External File: %s\n", filepath);
-		FILE* fileExt = fopen(filepath, "rb"); if (fileExt == NULL) { puts("ArgLink error: cannot open filepath in Read mode, source code line " STRINGIZE(__LINE__)); exit(66); }; size_t fileExtZone = (size_t)(s_ioBuffersKiB * 1024); char* fileExtBuffer = (fileExtZone > 0) ? (char*)calloc(fileExtZone, sizeof(char)) : NULL; setvbuf(fileExt, fileExtBuffer, fileExtBuffer ? _IOFBF : _IONBF, fileExtZone);
-		Recopy(fileExt, size, fileOut, offset);
-		fclose(fileExt); free(fileExtBuffer);
+		section->ExternalPath = filepath;
 	}
 }
 
-void InputSobStepTwo(ht* link, char* sobjName, FILE* fileSob, bool duplicateWarning)
+void InputSobStepTwo(SobObject* object, SobReader* fileSob)
 {
 	do {
-		LinkData* linktemp = (LinkData*)calloc(1, sizeof(LinkData)); if (linktemp == NULL) { puts("ArgLink error: cannot allocate for linktemp of type LinkData*, source code line " STRINGIZE(__LINE__)); exit(70); }
-		size_t nametempCount; char* nametemp = GetNameChars(fileSob, &nametempCount);
+		size_t nametempCount; const char* nametemp = GetNameChars(fileSob, &nametempCount);
 
 		if (nametempCount <= 0) {
 			break;
 		}
 
-		char* nametempString = (char*)calloc(nametempCount + 1, sizeof(char)); memmove(nametempString, nametemp, nametempCount);linktemp->Name = nametempString;
-		linktemp->Value = fgetc(fileSob) | (fgetc(fileSob) << 8) | (fgetc(fileSob) << 16);
-		linktemp->Origin = sobjName;
-		LuigiFormat("--%s : %X\n", linktemp->Name, linktemp->Value);
-		if (duplicateWarning && ht_get(link, linktemp->Name) != NULL) {
-			printf("ArgLink warning: Duplicate public symbol %s\n", linktemp->Name);
-		}
-		ht_set(link, linktemp->Name, linktemp);
-	} while (fgetc(fileSob) == 0);
-}
-
-void PerformLink(const ht* link, char* sobjFile, FILE* fileOut, const int64_t startLink[], int32_t n)
-{
-	FILE* fileSob = fopen(sobjFile, "rb"); if (fileSob == NULL) { puts("ArgLink error: cannot open sobjFile in Read mode, source code line " STRINGIZE(__LINE__)); exit(66); }; size_t fileSobZone = (size_t)(s_ioBuffersKiB * 1024); char* fileSobBuffer = (fileSobZone > 0) ? (char*)calloc(fileSobZone, sizeof(char)) : NULL; setvbuf(fileSob, fileSobBuffer, fileSobBuffer ? _IOFBF : _IONBF, fileSobZone);
-	fseek(fileSob, 0, SEEK_END); int64_t fileSize = ftell(fileSob);
-	LuigiFormat("Open %s\n", sobjFile);
-	fseek(fileSob, 0, SEEK_SET);
-	if (SOBJWasRead(fileSob)) {
-		int64_t startIndex = startLink[n];
-		if (startIndex < (fileSize - 3)) {
-			LuigiFormat("%X\n", startIndex);
-			fseek(fileSob, startIndex, SEEK_SET);
-			while (ftell(fileSob) < fileSize - 1) {
-				LuigiFormat("-%X\n", ftell(fileSob));
-				char* name = GetName(fileSob);
-				LinkData* at = (LinkData*)ht_get(link, name);
-
-				Calculation* linkcalc = NULL; size_t linkcalcCount = 0;
-				Calculation* calctemp = InitCalculation(-1, 0, 0, at->Value);
-				linkcalcCount++; linkcalc = (Calculation*)realloc(linkcalc, linkcalcCount * sizeof(Calculation));if (linkcalc == NULL) { puts("ArgLink error: cannot grow list of Calculation named linkcalc, source code line " STRINGIZE(__LINE__)); exit(70); }; linkcalc[linkcalcCount - 1] = *calctemp;
-
-				LuigiFormat("--%s : %X\n", name, at->Value);
-
-				if (fgetc(fileSob) != 0) {
-					fseek(fileSob, -1, SEEK_CUR);
-					name = GetName(fileSob);
-					at = (LinkData*)ht_get(link, name);
-					LuigiFormat("----%s : %X\n", name, at->Value);
-					if (fgetc(fileSob) == EOF) { puts("ArgLink error: reading byte from fileSob failed, source code line " STRINGIZE(__LINE__)); exit(74); };
-				}
+		if (object->PublicCount >= object->PublicCapacity) {
+			object->PublicCapacity = (object->PublicCapacity > 0) ? object->PublicCapacity * 2 : 64;
+			object->Publics = (PublicDef*)realloc(object->Publics, object->PublicCapacity * sizeof(PublicDef)); if (object->Publics == NULL) { puts("ArgLink error: cannot grow list of PublicDef named object->Publics, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+		}
+		PublicDef* linktemp = &object->Publics[object->PublicCount++];
+		linktemp->Name = nametemp;
+		linktemp->Length = nametempCount;
+		linktemp->Hash = ht_hash(nametemp, nametempCount);
+		linktemp->Value = SobReadByte(fileSob); linktemp->Value |= SobReadByte(fileSob) << 8; linktemp->Value |= SobReadByte(fileSob) << 16;
+	} while (SobGetc(fileSob) == 0);
+}
 
-				ReadLEInt32(fileSob);
-				ReadLEInt32(fileSob);
-
-				//List all operations
-				uint8_t calccheck1; { int whatRead = fgetc(fileSob); if (whatRead == EOF) { puts("ArgLink error: reading byte from fileSob failed, source code line " STRINGIZE(__LINE__)); exit(74); } else { calccheck1 = (uint8_t)whatRead; } };
-				uint8_t calccheck2; { int whatRead = fgetc(fileSob); if (whatRead == EOF) { puts("ArgLink error: reading byte from fileSob failed, source code line " STRINGIZE(__LINE__)); exit(74); } else { calccheck2 = (uint8_t)whatRead; } };
-				while (calccheck1 != 0 && calccheck2 != 0) {
-					// Note: ReadInt32() introduces a side effect and must be called under any circumstances
-					calctemp = InitCalculation((calccheck1 & 0x70) >> 4, calccheck1 & 0x3,
-						calccheck2, ReadLEInt32(fileSob));
-					if (calccheck1 > 0x80) {
-						calctemp->Value = at->Value;
-					}
+void ReadRelocations(SobObject* object)
+{
+	SobReader* fileSob = object->Contents;
+	int64_t fileSize = (int64_t)fileSob->Size;
+	object->StartLink = (int64_t)fileSob->Position;
+	object->Linkable = (object->StartLink < (fileSize - 3));
+	if (object->Linkable) {
+		while ((int64_t)fileSob->Position < fileSize - 1) {
+			if (object->RelocationCount >= object->RelocationCapacity) {
+				object->RelocationCapacity = (object->RelocationCapacity > 0) ? object->RelocationCapacity * 2 : 64;
+				object->Relocations = (Relocation*)realloc(object->Relocations, object->RelocationCapacity * sizeof(Relocation)); if (object->Relocations == NULL) { puts("ArgLink error: cannot grow list of Relocation named object->Relocations, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+			}
+			Relocation* reloc = &object->Relocations[object->RelocationCount++];
+			reloc->Position = (uint32_t)fileSob->Position;
+			reloc->Name = GetName(fileSob);
+			reloc->Secondary = NULL;
+			if (SobGetc(fileSob) != 0) {
+				fileSob->Position--;
+				reloc->Secondary = GetName(fileSob);
+				SobReadByte(fileSob);
+			}
+
+			ReadLEInt32(fileSob);
+			ReadLEInt32(fileSob);
 
-					{ int whatRead = fgetc(fileSob); if (whatRead == EOF) { puts("ArgLink error: reading byte from fileSob failed, source code line " STRINGIZE(__LINE__)); exit(74); } else { calccheck1 = (uint8_t)whatRead; } };
-					{ int whatRead = fgetc(fileSob); if (whatRead == EOF) { puts("ArgLink error: reading byte from fileSob failed, source code line " STRINGIZE(__LINE__)); exit(74); } else { calccheck2 = (uint8_t)whatRead; } };
-					linkcalcCount++; linkcalc = (Calculation*)realloc(linkcalc, linkcalcCount * sizeof(Calculation));if (linkcalc == NULL) { puts("ArgLink error: cannot grow list of Calculation named linkcalc, source code line " STRINGIZE(__LINE__)); exit(70); }; linkcalc[linkcalcCount - 1] = *calctemp;
+			//List all operations
+			reloc->FirstTerm = (uint32_t)object->TermCount;
+			uint8_t calccheck1 = SobReadByte(fileSob);
+			uint8_t calccheck2 = SobReadByte(fileSob);
+			while (calccheck1 != 0 && calccheck2 != 0) {
+				if (object->TermCount >= object->TermCapacity) {
+					object->TermCapacity = (object->TermCapacity > 0) ? object->TermCapacity * 2 : 64;
+					object->Terms = (RelocationTerm*)realloc(object->Terms, object->TermCapacity * sizeof(RelocationTerm)); if (object->Terms == NULL) { puts("ArgLink error: cannot grow list of RelocationTerm named object->Terms, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
 				}
+				RelocationTerm* term = &object->Terms[object->TermCount++];
+				term->Check1 = calccheck1;
+				term->Operation = calccheck2;
+				term->Value = ReadLEInt32(fileSob);
 
-				//All operations have been found, now do the calculations
-				while (linkcalcCount > 1) {
-					//Check for highest deep
-					int32_t highestdeep = -1;
-					int32_t highestdeepidx = -1;
-					int32_t i;
-					for (i = 1; i < (int32_t)linkcalcCount; i++) { // Cast for MSVC
-						//Get the first highest one
-						if (highestdeep < linkcalc[i].Deep) {
-							highestdeep = linkcalc[i].Deep;
-							highestdeepidx = i;
-						}
-					}
+				calccheck1 = SobReadByte(fileSob);
+				calccheck2 = SobReadByte(fileSob);
+			}
+			reloc->TermCount = (uint32_t)(object->TermCount - reloc->FirstTerm);
 
-					//Check for highest priority
-					int32_t highestpri = -1;
-					int32_t highestpriidx = -1;
-					for (i = highestdeepidx; i < (int32_t)linkcalcCount; i++) { // Cast for MSVC
-						//Get the first highest one
-						if (linkcalc[i].Deep != highestdeep || highestpri > linkcalc[i].Priority) {
-							break;
-						}
-
-						if (highestpri < linkcalc[i].Priority && linkcalc[i].Deep == highestdeep) {
-							highestpri = linkcalc[i].Priority;
-							highestpriidx = i;
-						}
-					}
+			reloc->Offset = ReadLEInt32(fileSob);
+			reloc->Format = SobReadByte(fileSob);
+		}
+	}
+}
 
-					//Check for latest deep
-					int32_t calcidx = -1;
-					for (i = highestpriidx; i >= 0; i--) {
-						//Get the first one that comes
-						if (highestdeep > linkcalc[i].Deep || highestpri > linkcalc[i].Priority) {
-							calcidx = i;
-							break;
-						}
-					}
+// Steps 1 & 2 without side effects: safe to run on several objects at once
+void ParseObject(SobObject* object)
+{
+	// Already open when it was fingerprinted for an incremental link
+	if (object->Contents != NULL) {
+		SobReaderRevalidate(object->Contents, object->Path);
+	}
+	SobReader* fileSob = (object->Contents != NULL) ? object->Contents : SobReaderOpen(object->Path);
+	fileSob->Position = 0;
+	object->Contents = fileSob;
+	object->FileSize = fileSob->Size;
+	object->ModifiedTime = fileSob->ModifiedTime;
+	object->IsSobj = SOBJWasRead(fileSob);
+	if (object->IsSobj) {
+		SobReadByte(fileSob);
+		SobReadByte(fileSob);
+		object->SectionCount = SobReadByte(fileSob);
+		SobReadByte(fileSob);
 
-					//Do the calculation
-					calctemp = &linkcalc[calcidx];
-
-					int32_t operation = linkcalc[highestpriidx].Operation;
-					int32_t calcValue = linkcalc[highestpriidx].Value;
-					if (operation == 0x02) { //Shift Right
-						LuigiFormat("%X >> %X\n", calctemp->Value, calcValue);
-						calctemp->Value >>= calcValue;
-					} else if (operation == 0x0C) { //Add
-						LuigiFormat("%X + %X\n", calctemp->Value, calcValue);
-						calctemp->Value += calcValue;
-					} else if (operation == 0x0E) { //Sub
-						LuigiFormat("%X - %X\n", calctemp->Value, calcValue);
-						calctemp->Value -= calcValue;
-					} else if (operation == 0x10) { //Mul
-						LuigiFormat("%X * %X\n", calctemp->Value, calcValue);
-						calctemp->Value *= calcValue;
-					} else if (operation == 0x12) { //Div
-						LuigiFormat("%X / %X\n", calctemp->Value, calcValue);
-						calctemp->Value /= calcValue;
-					} else if (operation == 0x16) { //And
-						LuigiFormat("%X & %X\n", calctemp->Value, calcValue);
-						calctemp->Value &= calcValue;
-					} else {
-						LuigiFormat("ERROR (CALCULATION) [%X]\n", operation);
-					}
+		object->Sections = (SectionWrite*)calloc((size_t)object->SectionCount + 1, sizeof(SectionWrite)); if (object->Sections == NULL) { puts("ArgLink error: cannot allocate for object->Sections of type SectionWrite*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+		for (int32_t i = 0; i < object->SectionCount; i++) {
+			// Step 1: Input all data
+			InputSobStepOne(&object->Sections[i], fileSob);
+		}
 
-					linkcalc[calcidx] = *calctemp;
-					size_t after = linkcalcCount - 1 - highestpriidx;
-							if (after > 0) {
-								memmove(&(linkcalc[highestpriidx]), &(linkcalc[highestpriidx + 1]), after * sizeof(Calculation));
-							}
-							linkcalcCount--;
-							linkcalc = (Calculation*)realloc(linkcalc, linkcalcCount * sizeof(Calculation)); if (linkcalc == NULL) { puts("ArgLink error: cannot trim list of Calculation named linkcalc, source code line " STRINGIZE(__LINE__)); exit(70); }
-				}
+		// Step 2: Get all extern names and values
+		InputSobStepTwo(object, fileSob);
 
-				//And then put the data in
-				int32_t offset = ReadLEInt32(fileSob);
-				fseek(fileOut, offset + 1, SEEK_SET);
-				LuigiFormat("----%X : %X\n", offset, linkcalc[0].Value);
-				uint8_t format; { int whatRead = fgetc(fileSob); if (whatRead == EOF) { puts("ArgLink error: reading byte from fileSob failed, source code line " STRINGIZE(__LINE__)); exit(74); } else { format = (uint8_t)whatRead; } };
-				int32_t firstValue = linkcalc[0].Value;
-				if (format == 0x00) { // 8-bit
-					fputc(firstValue, fileOut);
-				} else if (format == 0x02) { // 16-bit
-					fputc(firstValue & 0xff, fileOut); fputc(firstValue >> 8, fileOut);
-				} else if (format == 0x04) { // 24-bit
-					fputc(firstValue & 0xff, fileOut); fputc(firstValue >> 8, fileOut);
-					fputc((firstValue >> 16), fileOut);
-				} else if (format == 0x0E) { // 8-bit
-					fseek(fileOut, offset, SEEK_SET);
-					fputc(firstValue, fileOut);
-				} else if (format == 0x10) { // 16-bit
-					fseek(fileOut, offset, SEEK_SET);
-					fputc(firstValue & 0xff, fileOut); fputc(firstValue >> 8, fileOut);
-				} else {
-					LuigiOut("ERROR (OUTPUT)");
-				}
+		// Relocations are decoded now, so step 3 does not reopen the file
+		ReadRelocations(object);
+	}
+}
+
+void ParseObjectWork(void* objects, int32_t index)
+{
+	ParseObject(&((SobObject*)objects)[index]);
+}
+
+// Step 1 results go into the output, in command-line order so later objects overwrite earlier ones
+void MergeSections(const SobObject* object, RomImage* rom, ht* externals)
+{
+	for (int32_t i = 0; i < object->SectionCount; i++) {
+		const SectionWrite* section = &object->Sections[i];
+		LuigiFormat("%X: 0x%X /// Size: 0x%X / Offset 0x%X / Type %X", i,
+			section->Start, section->Size, section->Offset, section->Type);
+
+		if (section->Type == 0) {
+			RecopyBytes(section->Data, section->DataSize, section->Size, rom, section->Offset);
+		} else if (section->Type == 1) {
+			LuigiFormat("--Open External File: %s\n", section->ExternalPath);
+			uint8_t* target = RomImageAt(rom, section->Offset, section->Size);
+			size_t got = CopyExternal(externals, section->ExternalPath, 0, target, section->Size);
+			// A truncated file leaves zeroes, like a truncated section
+			memset(target + got, 0, section->Size - got);
+		}
+	}
+}
+
+// Step 2 results go into the symbol table, in command-line order so duplicates are reported
+// and overridden exactly as when loading one object at a time
+void MergePublics(SymbolTable* link, SobObject* object, bool duplicateWarning)
+{
+	for (size_t p = 0; p < object->PublicCount; p++) {
+		PublicDef* def = &object->Publics[p];
+		LuigiFormat("--%s : %X\n", def->Name, def->Value);
+
+		// One probe both detects a duplicate and interns the name in the table's key arena,
+		// which outlives the mapped file
+		uint32_t id = (uint32_t)link->Count;
+		const char* storedName;
+		void* previous = ht_get_or_insert_hashed(link->Index, def->Name, def->Length, def->Hash, SymbolRef(id), &storedName);
+		if (previous != NULL) {
+			// A redefinition keeps its ID and replaces the earlier value
+			if (duplicateWarning) {
+				printf("ArgLink warning: Duplicate public symbol %s\n", storedName);
 			}
+			id = SymbolId(previous);
+			link->Symbols[id].Definitions++;
 		} else {
-			LuigiOut("NOTHING");
+			if (link->Count >= link->Capacity) {
+				link->Capacity *= 2;
+				link->Symbols = (LinkData*)realloc(link->Symbols, link->Capacity * sizeof(LinkData)); if (link->Symbols == NULL) { puts("ArgLink error: cannot grow list of LinkData named link->Symbols, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+			}
+			link->Count++;
+			link->Symbols[id].Hash = def->Hash;
+			link->Symbols[id].Definitions = 1;
 		}
+
+		LinkData* linktemp = &link->Symbols[id];
+		linktemp->Name = storedName;
+		linktemp->Value = def->Value;
+		linktemp->Origin = object->Path;
+		def->Symbol = id;
 	}
-	fclose(fileSob); free(fileSobBuffer);
 }
 
-#pragma mark - Main entry point
-int main(int argc, char* argv[])
+void FreeParsedObject(SobObject* object)
 {
-	// TODO : get, split and parse ALFLAGS environment variable
-	// Do it before parsing command line so command line can override environment
-
-	// Parse command line
-	// "Sob" is the default file extension for ArgSfxX output, not to insult anybody
-	int32_t idx;
-	bool* areSobs = (bool*)calloc((size_t)(argc - 1), sizeof(bool)); if (areSobs == NULL) { puts("ArgLink error: cannot allocate for areSobs of type bool*, source code line " STRINGIZE(__LINE__)); exit(70); }
-	int32_t totalSobs = (argc - 1);
-	char* what;
-	bool hideLogo = false;
-	bool showPublics = false;
-	bool warnDupes = false;
-	char* romFile = NULL;
-	char* pubsPath = NULL;
-	char* passed;
-	uint8_t parsedU8;
-	uint16_t parsedU16;
+	for (int32_t i = 0; i < object->SectionCount; i++) {
+		free(object->Sections[i].ExternalPath);
+	}
+	free(object->Sections); object->Sections = NULL; object->SectionCount = 0;
+	free(object->Publics); object->Publics = NULL; object->PublicCount = 0;
+	free(object->Relocations); object->Relocations = NULL; object->RelocationCount = 0;
+	free(object->Terms); object->Terms = NULL; object->TermCount = 0;
+	free(object->Patches); object->Patches = NULL;
+}
 
-	// Fist pass only for the hideLogo switch, so any command line warning is shown after the logo
-	for (idx = 0; idx < (argc - 1); idx++) {
-		IsPositiveFlag('Q', argv[1 + idx], &hideLogo);
-		areSobs[idx] = true;
+// Without -H, the parsed publics size the table so it never expands while merging
+SymbolTable* SymbolTableFor(const SobObject objects[], int32_t objectCount, bool hashSizeGiven)
+{
+	size_t publicCount = 0;
+	for (int32_t o = 0; o < objectCount; o++) {
+		publicCount += objects[o].PublicCount;
 	}
-	if (!hideLogo) {
-		OutputLogo();
+	size_t hashCapacity = s_stringHashSize;
+	if (!hashSizeGiven) {
+		hashCapacity = publicCount * 100 / s_stringHashLoad + 1;
+		if (hashCapacity < 16) {
+			hashCapacity = 16;
+		}
 	}
+	return SymbolTableCreate(hashCapacity, hashSizeGiven ? s_stringHashSize : publicCount);
+}
 
-	for (idx = 0; idx < (argc - 1); idx++) {
-		passed = NULL;
-		parsedU8 = 0;
-		parsedU16 = 0;
-		what = argv[1 + idx];
-		if (IsPositiveFlag('V', what, &s_verbose) || IsPositiveFlag('Q', what, &hideLogo) ||
-			IsPositiveFlag('S', what, &showPublics) || IsPositiveFlag('C', what, &warnDupes) ||
-			IsStringFlag('O', what, &romFile) || IsStringFlag('X', what, &pubsPath) ||
-			IsIgnoredFlag('D', what) || IsIgnoredFlag('N', what) || IsIgnoredFlag('Y', what) ||
-			IsIgnoredFlag('F', what) || IsIgnoredFlag('P', what) || IsIgnoredFlag('A', what)) {
-			areSobs[idx] = false;
-			totalSobs--;
-		} else if (IsStringFlag('E', what, &passed)) {
-			if ((passed != NULL) && (strlen(passed) >= 2) && (passed[0] == '.')) {
-				s_defaultExtension = passed;
-			} else {
-				puts("ArgLink warning: default extension override must start with a dot.");
+// Steps 1 & 2 results, merged in command-line order; externals caches the external files.
+// link is NULL when the publics are in the symbol table already, as with a snapshot.
+void MergeObjects(SymbolTable* link, SobObject objects[], int32_t objectCount, RomImage* rom, ht* externals, bool duplicateWarning)
+{
+	for (int32_t o = 0; o < objectCount; o++) {
+		LuigiFormat("Open %s\n", objects[o].Path);
+		if (!objects[o].IsSobj) {
+			// Objects from a snapshot have no file open
+			if (objects[o].Contents != NULL) {
+				SobReaderClose(objects[o].Contents);
+				objects[o].Contents = NULL;
 			}
+			continue;
+		}
+		// Objects stay merged one at a time, as verbose output traces them, so the two
+		// steps take turns in their phases
+		StatsPhase(PhaseExternals);
+		MergeSections(&objects[o], rom, externals);
+		if (link != NULL) {
+			StatsPhase(PhasePublics);
+			MergePublics(link, &objects[o], duplicateWarning);
+		}
+		//Repeat
+	}
+}
 
-			areSobs[idx] = false;
-			totalSobs--;
-		} else if (IsStringFlag('W', what, &passed)) {
-			if (!((passed == NULL) || (strlen(passed) < 1))) {
+// Turns relocation names into symbol IDs once all publics are known. Every unresolved
+// name is reported, once, before giving up.
+void ResolveRelocations(const SymbolTable* link, SobObject objects[], int32_t objectCount)
+{
+	ht* unresolved = ht_create(16);
+	for (int32_t o = 0; o < objectCount; o++) {
+		for (size_t r = 0; r < objects[o].RelocationCount; r++) {
+			Relocation* reloc = &objects[o].Relocations[r];
+			const char* names[2] = { reloc->Name, (reloc->Secondary != NULL) ? reloc->Secondary : reloc->Name };
+			uint32_t* ids[2] = { &reloc->Symbol, &reloc->TermSymbol };
+			for (int k = 0; k < 2; k++) {
+				void* ref = ht_get(link->Index, names[k]);
+				if (ref != NULL) {
+					*ids[k] = SymbolId(ref);
+				} else if (ht_get(unresolved, names[k]) == NULL) {
+					printf("ArgLink error: unresolved symbol %s referenced by %s\n", names[k], objects[o].Path);
+					ht_set(unresolved, names[k], objects[o].Path);
+				}
+			}
+		}
+	}
+
+	size_t unresolvedCount = ht_length(unresolved);
+	ht_destroy(unresolved);
+	if (unresolvedCount > 0) {
+		printf("ArgLink error: %" PRIuPTR " unresolved symbol(s).\n", unresolvedCount);
+		LinkExit((int)BadInputData);
+	}
+}
+
+int32_t ApplyOperation(int32_t left, int32_t operation, int32_t right)
+{
+	if (operation == 0x02) { //Shift Right
+		LuigiFormat("%X >> %X\n", left, right);
+		return left >> right;
+	} else if (operation == 0x0C) { //Add
+		LuigiFormat("%X + %X\n", left, right);
+		return left + right;
+	} else if (operation == 0x0E) { //Sub
+		LuigiFormat("%X - %X\n", left, right);
+		return left - right;
+	} else if (operation == 0x10) { //Mul
+		LuigiFormat("%X * %X\n", left, right);
+		return left * right;
+	} else if (operation == 0x12) { //Div
+		LuigiFormat("%X / %X\n", left, right);
+		if (right == 0) { puts("ArgLink error: division by zero in a relocation, source code line " STRINGIZE(__LINE__)); LinkExit((int)BadInputData); }
+		// The one quotient that does not fit traps like a division by zero; it wraps instead
+		return ((left == INT32_MIN) && (right == -1)) ? left : left / right;
+	} else if (operation == 0x16) { //And
+		LuigiFormat("%X & %X\n", left, right);
+		return left & right;
+	} else {
+		LuigiFormat("ERROR (CALCULATION) [%X]\n", operation);
+		return left;
+	}
+}
+
+// Bytecode for relocation expressions; the stack starts with the value of the relocation's symbol
+typedef enum {
+	PushValue = 0,     // Push Operand
+	PushTermValue = 1, // Push the value of the flagged term symbol
+	Apply = 2          // Pop the top value and apply Operation to it and the value below
+} ExpressionOpcode;
+
+typedef struct ExpressionCode {
+	uint8_t Opcode;
+	uint8_t Operation;
+	int32_t Operand;
+} ExpressionCode;
+
+typedef struct Expression {
+	uint32_t FirstCode;    // Index into ExpressionTable.Code
+	uint32_t CodeCount;
+	bool UsesTermValue;    // Whether the result depends on the term symbol as well
+} Expression;
+
+// A memoized result, keyed by expression and symbol IDs
+typedef struct ExpressionResult {
+	uint32_t Expression;
+	uint32_t Symbol;
+	uint32_t TermSymbol;   // 0 unless the expression uses it
+	uint32_t Index;        // Into ExpressionTable.Results, plus 1 (0 marks an empty slot)
+} ExpressionResult;
+
+// Relocations with the same terms share one compiled expression, and each expression
+// is evaluated once per combination of symbols it is used with
+typedef struct ExpressionTable {
+	ht* Index;             // Text form of the terms, to expression ID + 1
+	Expression* Expressions;
+	size_t Count;
+	size_t Capacity;
+	ExpressionCode* Code;
+	size_t CodeCount;
+	size_t CodeCapacity;
+	ExpressionResult* Slots;
+	size_t SlotCapacity;   // Power of two, at least twice the number of relocations
+	int32_t* Results;
+	size_t ResultCount;
+	char* KeyBuffer;       // Text form of the terms being interned
+	size_t KeyCapacity;
+} ExpressionTable;
+
+void AppendExpressionCode(ExpressionTable* table, uint8_t opcode, uint8_t operation, int32_t operand)
+{
+	if (table->CodeCount >= table->CodeCapacity) {
+		table->CodeCapacity = (table->CodeCapacity > 0) ? table->CodeCapacity * 2 : 256;
+		table->Code = (ExpressionCode*)realloc(table->Code, table->CodeCapacity * sizeof(ExpressionCode)); if (table->Code == NULL) { puts("ArgLink error: cannot grow list of ExpressionCode named table->Code, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	}
+	ExpressionCode* code = &table->Code[table->CodeCount++];
+	code->Opcode = opcode;
+	code->Operation = operation;
+	code->Operand = operand;
+}
+
+// Terms act as left-associative operators ranked by deep, then priority: a term is applied
+// to the operand on its left once the next term does not rank higher. This gives the same
+// result as repeatedly applying the first highest-ranked term, and turns the terms into
+// postfix code in one pass.
+void CompileExpression(ExpressionTable* table, Expression* expression, const RelocationTerm terms[], uint32_t termCount)
+{
+	Calculation stack[CALCULATION_STACK];
+	size_t top = 0;
+	expression->FirstCode = (uint32_t)table->CodeCount;
+	expression->UsesTermValue = false;
+
+	for (uint32_t t = 0; t <= termCount; t++) {
+		// Past the last term, rank -1 applies everything left on the stack
+		int32_t rank = (t < termCount) ? ((terms[t].Check1 & 0x70) >> 4) * 4 + (terms[t].Check1 & 0x3) : -1;
+		while ((top > 0) && (stack[top].Rank >= rank)) {
+			AppendExpressionCode(table, Apply, (uint8_t)stack[top].Operation, 0);
+			top--;
+		}
+		if (t < termCount) {
+			if (terms[t].Check1 > 0x80) {
+				AppendExpressionCode(table, PushTermValue, 0, 0);
+				expression->UsesTermValue = true;
+			} else {
+				AppendExpressionCode(table, PushValue, 0, terms[t].Value);
+			}
+			top++;
+			stack[top].Rank = rank;
+			stack[top].Operation = terms[t].Operation;
+		}
+	}
+	expression->CodeCount = (uint32_t)table->CodeCount - expression->FirstCode;
+}
+
+// Runs without allocating: compiled code never needs more than CALCULATION_STACK values
+int32_t RunExpression(const ExpressionTable* table, uint32_t id, int32_t initialValue, int32_t termValue)
+{
+	const Expression* expression = &table->Expressions[id];
+	const ExpressionCode* code = &table->Code[expression->FirstCode];
+	int32_t stack[CALCULATION_STACK];
+	size_t top = 0;
+	stack[0] = initialValue;
+	for (uint32_t c = 0; c < expression->CodeCount; c++) {
+		if (code[c].Opcode == PushValue) {
+			stack[++top] = code[c].Operand;
+		} else if (code[c].Opcode == PushTermValue) {
+			stack[++top] = termValue;
+		} else {
+			stack[top - 1] = ApplyOperation(stack[top - 1], code[c].Operation, stack[top]);
+			top--;
+		}
+	}
+	return stack[0];
+}
+
+// Returns the ID of the expression for these terms, compiling it the first time
+uint32_t InternExpression(ExpressionTable* table, const RelocationTerm terms[], uint32_t termCount)
+{
+	// Text form: 12 hex digits per term; flagged terms ignore their own value
+	size_t length = (size_t)termCount * 12;
+	if (length + 1 > table->KeyCapacity) {
+		table->KeyCapacity = (length + 1) * 2;
+		table->KeyBuffer = (char*)realloc(table->KeyBuffer, table->KeyCapacity); if (table->KeyBuffer == NULL) { puts("ArgLink error: cannot grow expression key buffer, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	}
+	char* key = table->KeyBuffer;
+	for (uint32_t t = 0; t < termCount; t++) {
+		uint32_t value = (terms[t].Check1 > 0x80) ? 0 : (uint32_t)terms[t].Value;
+		snprintf(key + t * 12, 13, "%02X%02X%08" PRIX32, terms[t].Check1, terms[t].Operation, value);
+	}
+	key[length] = '\0';
+
+	uint64_t hash = ht_hash(key, length);
+	void* ref = ht_get_hashed(table->Index, key, length, hash);
+	if (ref != NULL) {
+		return SymbolId(ref);
+	}
+
+	if (table->Count >= table->Capacity) {
+		table->Capacity = (table->Capacity > 0) ? table->Capacity * 2 : 64;
+		table->Expressions = (Expression*)realloc(table->Expressions, table->Capacity * sizeof(Expression)); if (table->Expressions == NULL) { puts("ArgLink error: cannot grow list of Expression named table->Expressions, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	}
+	uint32_t id = (uint32_t)table->Count++;
+	CompileExpression(table, &table->Expressions[id], terms, termCount);
+	ht_upsert_hashed(table->Index, key, length, hash, SymbolRef(id), NULL);
+	return id;
+}
+
+// Returns the index of the result for this expression and these symbols, evaluating it the first time
+uint32_t MemoizeExpression(ExpressionTable* table, const LinkData symbols[], uint32_t id, uint32_t symbol, uint32_t termSymbol)
+{
+	ExpressionResult key;
+	memset(&key, 0, sizeof(key));
+	key.Expression = id;
+	key.Symbol = symbol;
+	key.TermSymbol = table->Expressions[id].UsesTermValue ? termSymbol : 0;
+
+	size_t mask = table->SlotCapacity - 1;
+	size_t index = (size_t)ht_hash((const char*)&key, offsetof(ExpressionResult, Index)) & mask;
+	for (;;) {
+		ExpressionResult* slot = &table->Slots[index];
+		if (slot->Index == 0) {
+			break;
+		}
+		if ((slot->Expression == key.Expression) && (slot->Symbol == key.Symbol) && (slot->TermSymbol == key.TermSymbol)) {
+			return slot->Index - 1;
+		}
+		index = (index + 1) & mask;
+	}
+
+	// Verbose output traces every evaluation where it happens, so results are then left to step 3
+	uint32_t result = (uint32_t)table->ResultCount++;
+	if (!s_verbose) {
+		table->Results[result] = RunExpression(table, id, symbols[symbol].Value, symbols[termSymbol].Value);
+	}
+	key.Index = result + 1;
+	table->Slots[index] = key;
+	return result;
+}
+
+// Room for the results of relocationCount relocations
+ExpressionTable* ExpressionTableCreate(size_t relocationCount)
+{
+	ExpressionTable* table = (ExpressionTable*)calloc(1, sizeof(ExpressionTable)); if (table == NULL) { puts("ArgLink error: cannot allocate for table of type ExpressionTable*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	table->Index = ht_create(64); if (table->Index == NULL) { puts("ArgLink error: cannot allocate expression index, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	table->SlotCapacity = ht_round_capacity(relocationCount * 2 + 16);
+	table->Slots = (ExpressionResult*)calloc(table->SlotCapacity, sizeof(ExpressionResult)); if (table->Slots == NULL) { puts("ArgLink error: cannot allocate for table->Slots of type ExpressionResult*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	table->Results = (int32_t*)calloc(relocationCount + 1, sizeof(int32_t)); if (table->Results == NULL) { puts("ArgLink error: cannot allocate for table->Results of type int32_t*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	return table;
+}
+
+size_t CountRelocations(const SobObject objects[], int32_t objectCount)
+{
+	size_t relocationCount = 0;
+	for (int32_t o = 0; o < objectCount; o++) {
+		relocationCount += objects[o].RelocationCount;
+	}
+	return relocationCount;
+}
+
+// Gives every relocation an expression ID and a result index in a table sized by
+// CountRelocations; runs once all symbols are resolved
+void CompileRelocations(ExpressionTable* table, const LinkData symbols[], SobObject objects[], int32_t objectCount)
+{
+	for (int32_t o = 0; o < objectCount; o++) {
+		for (size_t r = 0; r < objects[o].RelocationCount; r++) {
+			Relocation* reloc = &objects[o].Relocations[r];
+			reloc->Expression = InternExpression(table, &objects[o].Terms[reloc->FirstTerm], reloc->TermCount);
+			reloc->Result = MemoizeExpression(table, symbols, reloc->Expression, reloc->Symbol, reloc->TermSymbol);
+		}
+	}
+}
+
+void ExpressionTableDestroy(ExpressionTable* table)
+{
+	ht_destroy(table->Index);
+	free(table->Expressions);
+	free(table->Code);
+	free(table->Slots);
+	free(table->Results);
+	free(table->KeyBuffer);
+	free(table);
+}
+
+void PerformLink(const LinkData symbols[], const ExpressionTable* expressions, SobObject* object)
+{
+	object->Patches = (Patch*)calloc(object->RelocationCount + 1, sizeof(Patch)); if (object->Patches == NULL) { puts("ArgLink error: cannot allocate for object->Patches of type Patch*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	LuigiFormat("Open %s\n", object->Path);
+	if (object->Linkable) {
+		LuigiFormat("%X\n", object->StartLink);
+		for (size_t r = 0; r < object->RelocationCount; r++) {
+			const Relocation* reloc = &object->Relocations[r];
+			LuigiFormat("-%X\n", reloc->Position);
+			const LinkData* at = &symbols[reloc->Symbol];
+
+			LuigiFormat("--%s : %X\n", reloc->Name, at->Value);
+			int32_t initialValue = at->Value;
+
+			if (reloc->Secondary != NULL) {
+				at = &symbols[reloc->TermSymbol];
+				LuigiFormat("----%s : %X\n", reloc->Secondary, at->Value);
+			}
+
+			int32_t result = s_verbose ?
+				RunExpression(expressions, reloc->Expression, initialValue, at->Value) : expressions->Results[reloc->Result];
+
+			//And then work out where the data goes
+			int32_t offset = reloc->Offset;
+			LuigiFormat("----%X : %X\n", offset, result);
+			uint8_t format = reloc->Format;
+			Patch* patch = &object->Patches[r];
+			patch->Value = result;
+			if (format == 0x00) { // 8-bit
+				patch->Start = (int64_t)offset + 1; patch->Width = 1;
+			} else if (format == 0x02) { // 16-bit
+				patch->Start = (int64_t)offset + 1; patch->Width = 2;
+			} else if (format == 0x04) { // 24-bit
+				patch->Start = (int64_t)offset + 1; patch->Width = 3;
+			} else if (format == 0x0E) { // 8-bit
+				patch->Start = offset; patch->Width = 1;
+			} else if (format == 0x10) { // 16-bit
+				patch->Start = offset; patch->Width = 2;
+			} else {
+				LuigiOut("ERROR (OUTPUT)");
+			}
+		}
+	} else {
+		LuigiOut("NOTHING");
+	}
+}
+
+typedef struct LinkWork {
+	const LinkData* Symbols;
+	const ExpressionTable* Expressions;
+	SobObject* Objects;
+} LinkWork;
+
+void PerformLinkWork(void* context, int32_t index)
+{
+	LinkWork* work = (LinkWork*)context;
+	if (work->Objects[index].IsSobj) {
+		PerformLink(work->Symbols, work->Expressions, &work->Objects[index]);
+	}
+}
+
+// A patch in the batch for the whole ROM, with its place in serial link order
+typedef struct PatchRecord {
+	int64_t Start;
+	int32_t Value;
+	uint8_t Width;
+	int32_t Object;
+	uint32_t Relocation;
+} PatchRecord;
+
+int ComparePatchStarts(const void* a, const void* b)
+{
+	const PatchRecord* left = (const PatchRecord*)a;
+	const PatchRecord* right = (const PatchRecord*)b;
+	if (left->Start != right->Start) {
+		return (left->Start > right->Start) ? 1 : -1;
+	}
+	if (left->Object != right->Object) {
+		return (left->Object > right->Object) ? 1 : -1;
+	}
+	return (left->Relocation > right->Relocation) - (left->Relocation < right->Relocation);
+}
+
+int ComparePatchOrder(const void* a, const void* b)
+{
+	const PatchRecord* left = (const PatchRecord*)a;
+	const PatchRecord* right = (const PatchRecord*)b;
+	if (left->Object != right->Object) {
+		return (left->Object > right->Object) ? 1 : -1;
+	}
+	return (left->Relocation > right->Relocation) - (left->Relocation < right->Relocation);
+}
+
+void StorePatch(uint8_t* target, const PatchRecord* patch)
+{
+	switch (patch->Width) {
+	case 1:
+		target[0] = (uint8_t)patch->Value;
+		break;
+	case 2:
+		target[0] = (uint8_t)(patch->Value & 0xff); target[1] = (uint8_t)(patch->Value >> 8);
+		break;
+	default:
+		target[0] = (uint8_t)(patch->Value & 0xff); target[1] = (uint8_t)(patch->Value >> 8);
+		target[2] = (uint8_t)(patch->Value >> 16);
+		break;
+	}
+}
+
+// How relocations writing the same ROM bytes are reported
+typedef enum {
+	OverlapsQuiet = 0,   // Nothing, for the full link of --verify-full
+	OverlapsCounted = 1, // One warning with the number of overlaps
+	OverlapsListed = 2   // -C: one warning per overlap
+} OverlapReport;
+
+// All patches of a link, sorted by ComparePatchStarts
+typedef struct PatchIndex {
+	PatchRecord* Records;
+	size_t Count;
+	size_t Overlaps;     // Groups of patches sharing ROM bytes
+} PatchIndex;
+
+// The end of the group of overlapping patches that starts at first
+size_t PatchGroupEnd(const PatchRecord patches[], size_t patchCount, size_t first)
+{
+	size_t last = first + 1;
+	int64_t groupEnd = patches[first].Start + patches[first].Width;
+	while ((last < patchCount) && (patches[last].Start < groupEnd)) {
+		if (patches[last].Start + patches[last].Width > groupEnd) {
+			groupEnd = patches[last].Start + patches[last].Width;
+		}
+		last++;
+	}
+	return last;
+}
+
+void ReportOverlapCount(size_t overlaps)
+{
+	if (overlaps > 0) {
+		printf("ArgLink warning: relocations overlap at %" PRIuPTR " ROM offset(s), -C lists them.\n", overlaps);
+	}
+}
+
+// Writes every patch in one forward sweep, sorted by offset. Patches sharing bytes are
+// reported, then written in serial link order so the last one still wins. Returns the
+// sorted patches, for an incremental link to start from.
+PatchIndex ApplyPatches(const SobObject objects[], int32_t objectCount, RomImage* rom, OverlapReport report)
+{
+	size_t patchCount = 0;
+	for (int32_t o = 0; o < objectCount; o++) {
+		patchCount += objects[o].RelocationCount;
+	}
+	PatchRecord* patches = (PatchRecord*)calloc(patchCount + 1, sizeof(PatchRecord)); if (patches == NULL) { puts("ArgLink error: cannot allocate for patches of type PatchRecord*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	patchCount = 0;
+	for (int32_t o = 0; o < objectCount; o++) {
+		for (size_t r = 0; r < objects[o].RelocationCount; r++) {
+			const Patch* patch = &objects[o].Patches[r];
+			if (patch->Width > 0) {
+				PatchRecord* record = &patches[patchCount++];
+				record->Start = patch->Start;
+				record->Value = patch->Value;
+				record->Width = patch->Width;
+				record->Object = o;
+				record->Relocation = (uint32_t)r;
+			}
+		}
+	}
+	qsort(patches, patchCount, sizeof(PatchRecord), ComparePatchStarts);
+
+	// Sorted, out-of-range offsets are all at the front, and the last patch ends the ROM
+	size_t outOfRange = 0;
+	for (; (outOfRange < patchCount) && (patches[outOfRange].Start < 0); outOfRange++) {
+		printf("ArgLink error: relocation in %s patches ROM offset %" PRId64 "\n", objects[patches[outOfRange].Object].Path, patches[outOfRange].Start);
+	}
+	if (outOfRange > 0) {
+		printf("ArgLink error: %" PRIuPTR " relocation(s) out of range.\n", outOfRange);
+		LinkExit((int)BadInputData);
+	}
+	int64_t end = 0;
+	for (size_t i = 0; i < patchCount; i++) {
+		if (patches[i].Start + patches[i].Width > end) {
+			end = patches[i].Start + patches[i].Width;
+		}
+	}
+	if (end > 0) {
+		RomImageAt(rom, end - 1, 1);
+	}
+
+	// Overlapping groups are put in serial order in a copy, so the index stays sorted
+	PatchIndex index = { patches, patchCount, 0 };
+	PatchRecord* group = NULL;
+	size_t groupCapacity = 0;
+	for (size_t first = 0; first < patchCount; ) {
+		size_t last = PatchGroupEnd(patches, patchCount, first);
+		if (last - first == 1) {
+			StorePatch(rom->Bytes + patches[first].Start, &patches[first]);
+			first = last;
+			continue;
+		}
+		if (last - first > groupCapacity) {
+			groupCapacity = (last - first) * 2;
+			group = (PatchRecord*)realloc(group, groupCapacity * sizeof(PatchRecord)); if (group == NULL) { puts("ArgLink error: cannot grow list of PatchRecord named group, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+		}
+		memcpy(group, &patches[first], (last - first) * sizeof(PatchRecord));
+		qsort(group, last - first, sizeof(PatchRecord), ComparePatchOrder);
+		index.Overlaps++;
+		if (report == OverlapsListed) {
+			printf("ArgLink warning: %" PRIuPTR " relocations overlap at ROM offset %" PRIX64 " (first from %s, last from %s)\n",
+				last - first, (uint64_t)group[0].Start, objects[group[0].Object].Path, objects[group[last - first - 1].Object].Path);
+		}
+		for (size_t i = 0; i < last - first; i++) {
+			StorePatch(rom->Bytes + group[i].Start, &group[i]);
+		}
+		first = last;
+	}
+	free(group);
+	if (report == OverlapsCounted) {
+		ReportOverlapCount(index.Overlaps);
+	}
+	return index;
+}
+
+// Step 3. With one job (or verbose output, which must stay in order) objects are evaluated
+// one after another, otherwise on worker threads against the final symbol table.
+// Either way the patches are then written together.
+PatchIndex LinkObjects(const LinkData symbols[], const ExpressionTable* expressions, SobObject objects[], int32_t objectCount, RomImage* rom, OverlapReport report)
+{
+	LinkWork work;
+	work.Symbols = symbols;
+	work.Expressions = expressions;
+	work.Objects = objects;
+	RunOnWorkers(s_verbose ? 1 : s_jobs, objectCount, PerformLinkWork, &work);
+	return ApplyPatches(objects, objectCount, rom, report);
+}
+
+#pragma mark - State writer
+// Link states, snapshots and symbol databases are built in memory, little-endian, then written at once
+typedef struct StateWriter {
+	uint8_t* Bytes;
+	size_t Size;
+	size_t Capacity;
+} StateWriter;
+
+// Makes room for count more bytes at once, for writers that know their size
+void ReserveBytes(StateWriter* writer, size_t count)
+{
+	if (writer->Size + count > writer->Capacity) {
+		writer->Capacity = writer->Size + count;
+		writer->Bytes = (uint8_t*)realloc(writer->Bytes, writer->Capacity); if (writer->Bytes == NULL) { puts("ArgLink error: cannot grow state writer bytes, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	}
+}
+
+void PutBytes(StateWriter* writer, const void* bytes, size_t count)
+{
+	if (writer->Size + count > writer->Capacity) {
+		writer->Capacity = (writer->Capacity > 0) ? writer->Capacity * 2 : 65536;
+		if (writer->Capacity < writer->Size + count) {
+			writer->Capacity = writer->Size + count;
+		}
+		writer->Bytes = (uint8_t*)realloc(writer->Bytes, writer->Capacity); if (writer->Bytes == NULL) { puts("ArgLink error: cannot grow state writer bytes, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	}
+	memcpy(writer->Bytes + writer->Size, bytes, count);
+	writer->Size += count;
+}
+
+void PutByte(StateWriter* writer, uint8_t value)
+{
+	PutBytes(writer, &value, 1);
+}
+
+void PutLEInt32(StateWriter* writer, int32_t value)
+{
+	uint8_t bytes[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+	// Records are written field by field, mostly into reserved room
+	if (writer->Size + 4 <= writer->Capacity) {
+		memcpy(writer->Bytes + writer->Size, bytes, 4);
+		writer->Size += 4;
+		return;
+	}
+	PutBytes(writer, bytes, 4);
+}
+
+void PutLEInt64(StateWriter* writer, uint64_t value)
+{
+	PutLEInt32(writer, (int32_t)(uint32_t)value);
+	PutLEInt32(writer, (int32_t)(uint32_t)(value >> 32));
+}
+
+#pragma mark - Link records
+// Objects and their symbol table as link states and snapshots both save them: fixed-size
+// records, little-endian with 32-bit fields, in the order below. Names and paths are offsets
+// into a string pool that the file holds after its records.
+#define LINK_RECORD_OBJECT 68     // Path, size, time and fingerprint (64-bit), first section, section count, first public, public count, first relocation, relocation count, first term, term count, StartLink, flags
+#define LINK_RECORD_SYMBOL 24     // Name, hash (64-bit), origin object, value, definitions
+#define LINK_RECORD_SECTION 20    // Start, offset, size, type, external path
+#define LINK_RECORD_PUBLIC 8      // Symbol, value
+#define LINK_RECORD_RELOCATION 28 // Symbol, term symbol, position, offset, first term in its object, term count, format and flags
+#define LINK_RECORD_TERM 8        // Check1, operation, 2 zero bytes, value
+#define LINK_RECORD_IS_SOBJ 1
+#define LINK_RECORD_LINKABLE 2
+#define LINK_RECORD_SECONDARY 0x100
+
+// How many records of each kind, as file headers hold them after the version
+typedef struct LinkRecordCounts {
+	uint32_t Objects;
+	uint32_t Symbols;
+	uint32_t Sections;
+	uint32_t Publics;
+	uint32_t Relocations;
+	uint32_t Terms;
+} LinkRecordCounts;
+
+// Appends a string to the pool, returning its offset
+uint32_t PutPooled(StateWriter* pool, const char* text, size_t length)
+{
+	uint32_t offset = (uint32_t)pool->Size;
+	PutBytes(pool, text, length);
+	PutByte(pool, 0);
+	return offset;
+}
+
+uint32_t SnapshotField(const uint8_t* record, size_t field)
+{
+	const uint8_t* at = record + field * 4;
+	return (uint32_t)at[0] | ((uint32_t)at[1] << 8) | ((uint32_t)at[2] << 16) | ((uint32_t)at[3] << 24);
+}
+
+uint64_t StateField64(const uint8_t* record, size_t field)
+{
+	return SnapshotField(record, field) | ((uint64_t)SnapshotField(record, field + 1) << 32);
+}
+
+uint64_t LinkRecordsSize(const LinkRecordCounts* counts)
+{
+	return (uint64_t)counts->Objects * LINK_RECORD_OBJECT + (uint64_t)counts->Symbols * LINK_RECORD_SYMBOL +
+		(uint64_t)counts->Sections * LINK_RECORD_SECTION + (uint64_t)counts->Publics * LINK_RECORD_PUBLIC +
+		(uint64_t)counts->Relocations * LINK_RECORD_RELOCATION + (uint64_t)counts->Terms * LINK_RECORD_TERM;
+}
+
+void PutLinkRecordCounts(StateWriter* header, const LinkRecordCounts* counts)
+{
+	PutLEInt32(header, (int32_t)counts->Objects);
+	PutLEInt32(header, (int32_t)counts->Symbols);
+	PutLEInt32(header, (int32_t)counts->Sections);
+	PutLEInt32(header, (int32_t)counts->Publics);
+	PutLEInt32(header, (int32_t)counts->Relocations);
+	PutLEInt32(header, (int32_t)counts->Terms);
+}
+
+// From the header fields that follow "ALST" or "ALSN" and the version
+LinkRecordCounts GetLinkRecordCounts(const uint8_t* header)
+{
+	LinkRecordCounts counts;
+	counts.Objects = SnapshotField(header, 2);
+	counts.Symbols = SnapshotField(header, 3);
+	counts.Sections = SnapshotField(header, 4);
+	counts.Publics = SnapshotField(header, 5);
+	counts.Relocations = SnapshotField(header, 6);
+	counts.Terms = SnapshotField(header, 7);
+	return counts;
+}
+
+LinkRecordCounts PutLinkRecords(StateWriter* records, StateWriter* pool, const SymbolTable* link, const SobObject objects[], int32_t objectCount)
+{
+	LinkRecordCounts counts;
+	memset(&counts, 0, sizeof(counts));
+	counts.Objects = (uint32_t)objectCount;
+	counts.Symbols = (uint32_t)link->Count;
+
+	size_t recordSize = (size_t)objectCount * LINK_RECORD_OBJECT + link->Count * LINK_RECORD_SYMBOL;
+	for (int32_t o = 0; o < objectCount; o++) {
+		recordSize += (size_t)objects[o].SectionCount * LINK_RECORD_SECTION + objects[o].PublicCount * LINK_RECORD_PUBLIC +
+			objects[o].RelocationCount * LINK_RECORD_RELOCATION + objects[o].TermCount * LINK_RECORD_TERM;
+	}
+	ReserveBytes(records, recordSize);
+	for (int32_t o = 0; o < objectCount; o++) {
+		const SobObject* object = &objects[o];
+		PutLEInt32(records, (int32_t)PutPooled(pool, object->Path, strlen(object->Path)));
+		PutLEInt64(records, object->FileSize);
+		PutLEInt64(records, (uint64_t)object->ModifiedTime);
+		PutLEInt64(records, object->Fingerprint);
+		PutLEInt32(records, (int32_t)counts.Sections);
+		PutLEInt32(records, object->SectionCount);
+		PutLEInt32(records, (int32_t)counts.Publics);
+		PutLEInt32(records, (int32_t)object->PublicCount);
+		PutLEInt32(records, (int32_t)counts.Relocations);
+		PutLEInt32(records, (int32_t)object->RelocationCount);
+		PutLEInt32(records, (int32_t)counts.Terms);
+		PutLEInt32(records, (int32_t)object->TermCount);
+		PutLEInt32(records, (int32_t)object->StartLink);
+		PutLEInt32(records, (object->IsSobj ? LINK_RECORD_IS_SOBJ : 0) | (object->Linkable ? LINK_RECORD_LINKABLE : 0));
+		counts.Sections += (uint32_t)object->SectionCount;
+		counts.Publics += (uint32_t)object->PublicCount;
+		counts.Relocations += (uint32_t)object->RelocationCount;
+		counts.Terms += (uint32_t)object->TermCount;
+	}
+
+	// Symbols refer to the object defining them by index
+	ht* origins = ht_create(64);
+	for (int32_t o = 0; o < objectCount; o++) {
+		ht_set(origins, objects[o].Path, SymbolRef((uint32_t)o));
+	}
+	for (size_t id = 0; id < link->Count; id++) {
+		const LinkData* symbol = &link->Symbols[id];
+		PutLEInt32(records, (int32_t)PutPooled(pool, symbol->Name, strlen(symbol->Name)));
+		PutLEInt64(records, symbol->Hash);
+		PutLEInt32(records, (int32_t)SymbolId(ht_get(origins, symbol->Origin)));
+		PutLEInt32(records, symbol->Value);
+		PutLEInt32(records, (int32_t)symbol->Definitions);
+	}
+	ht_destroy(origins);
+
+	for (int32_t o = 0; o < objectCount; o++) {
+		for (int32_t i = 0; i < objects[o].SectionCount; i++) {
+			const SectionWrite* section = &objects[o].Sections[i];
+			PutLEInt32(records, (int32_t)section->Start);
+			PutLEInt32(records, section->Offset);
+			PutLEInt32(records, (int32_t)(uint32_t)section->Size);
+			PutLEInt32(records, section->Type);
+			PutLEInt32(records, (section->ExternalPath != NULL) ? (int32_t)PutPooled(pool, section->ExternalPath, strlen(section->ExternalPath)) : 0);
+		}
+	}
+	for (int32_t o = 0; o < objectCount; o++) {
+		for (size_t p = 0; p < objects[o].PublicCount; p++) {
+			PutLEInt32(records, (int32_t)objects[o].Publics[p].Symbol);
+			PutLEInt32(records, objects[o].Publics[p].Value);
+		}
+	}
+	for (int32_t o = 0; o < objectCount; o++) {
+		for (size_t r = 0; r < objects[o].RelocationCount; r++) {
+			const Relocation* reloc = &objects[o].Relocations[r];
+			PutLEInt32(records, (int32_t)reloc->Symbol);
+			PutLEInt32(records, (int32_t)reloc->TermSymbol);
+			PutLEInt32(records, (int32_t)reloc->Position);
+			PutLEInt32(records, reloc->Offset);
+			PutLEInt32(records, (int32_t)reloc->FirstTerm);
+			PutLEInt32(records, (int32_t)reloc->TermCount);
+			PutLEInt32(records, reloc->Format | ((reloc->Secondary != NULL) ? LINK_RECORD_SECONDARY : 0));
+		}
+	}
+	for (int32_t o = 0; o < objectCount; o++) {
+		for (size_t t = 0; t < objects[o].TermCount; t++) {
+			const RelocationTerm* term = &objects[o].Terms[t];
+			uint8_t record[LINK_RECORD_TERM] = { term->Check1, term->Operation, 0, 0, (uint8_t)term->Value, (uint8_t)(term->Value >> 8), (uint8_t)(term->Value >> 16), (uint8_t)(term->Value >> 24) };
+			PutBytes(records, record, LINK_RECORD_TERM);
+		}
+	}
+	return counts;
+}
+
+// Fills objects, zeroed, from the records at records and rebuilds their symbol table as it
+// was, IDs included. Names and object paths point into pool, which the caller checked ends
+// with a 0; kind and path name the file in messages.
+SymbolTable* ReadLinkRecords(const uint8_t* records, const LinkRecordCounts* counts, const char* pool, uint32_t poolSize, SobObject objects[], const char* kind, const char* path)
+{
+	const uint8_t* objectRecords = records;
+	const uint8_t* symbolRecords = objectRecords + (size_t)counts->Objects * LINK_RECORD_OBJECT;
+	const uint8_t* sectionRecords = symbolRecords + (size_t)counts->Symbols * LINK_RECORD_SYMBOL;
+	const uint8_t* publicRecords = sectionRecords + (size_t)counts->Sections * LINK_RECORD_SECTION;
+	const uint8_t* relocationRecords = publicRecords + (size_t)counts->Publics * LINK_RECORD_PUBLIC;
+	const uint8_t* termRecords = relocationRecords + (size_t)counts->Relocations * LINK_RECORD_RELOCATION;
+
+	SymbolTable* link = SymbolTableCreate((size_t)counts->Symbols * 100 / s_stringHashLoad + 16, counts->Symbols);
+	for (uint32_t id = 0; id < counts->Symbols; id++) {
+		const uint8_t* record = symbolRecords + (size_t)id * LINK_RECORD_SYMBOL;
+		uint32_t name = SnapshotField(record, 0), origin = SnapshotField(record, 3);
+		if ((name >= poolSize) || (origin >= counts->Objects) || (SnapshotField(objectRecords + (size_t)origin * LINK_RECORD_OBJECT, 0) >= poolSize)) {
+			printf("ArgLink error: %s %s is damaged, source code line " STRINGIZE(__LINE__) "\n", kind, path); LinkExit(65);
+		}
+		LinkData* symbol = &link->Symbols[link->Count++];
+		symbol->Hash = StateField64(record, 1);
+		if (ht_upsert_hashed(link->Index, pool + name, strlen(pool + name), symbol->Hash, SymbolRef(id), &symbol->Name) != NULL) {
+			printf("ArgLink error: %s %s is damaged, source code line " STRINGIZE(__LINE__) "\n", kind, path); LinkExit(65);
+		}
+		symbol->Origin = (char*)pool + SnapshotField(objectRecords + (size_t)origin * LINK_RECORD_OBJECT, 0);
+		symbol->Value = (int32_t)SnapshotField(record, 4);
+		symbol->Definitions = SnapshotField(record, 5);
+	}
+
+	for (uint32_t o = 0; o < counts->Objects; o++) {
+		const uint8_t* record = objectRecords + (size_t)o * LINK_RECORD_OBJECT;
+		SobObject* object = &objects[o];
+		uint32_t pathAt = SnapshotField(record, 0), firstSection = SnapshotField(record, 7), firstPublic = SnapshotField(record, 9);
+		uint32_t firstRelocation = SnapshotField(record, 11), firstTerm = SnapshotField(record, 13);
+		object->SectionCount = (int32_t)SnapshotField(record, 8);
+		object->PublicCount = SnapshotField(record, 10);
+		object->RelocationCount = SnapshotField(record, 12);
+		object->TermCount = SnapshotField(record, 14);
+		if ((pathAt >= poolSize) || (object->SectionCount < 0) || ((uint64_t)firstSection + (uint32_t)object->SectionCount > counts->Sections) ||
+			((uint64_t)firstPublic + object->PublicCount > counts->Publics) || ((uint64_t)firstRelocation + object->RelocationCount > counts->Relocations) ||
+			((uint64_t)firstTerm + object->TermCount > counts->Terms)) {
+			printf("ArgLink error: %s %s is damaged, source code line " STRINGIZE(__LINE__) "\n", kind, path); LinkExit(65);
+		}
+		object->Path = (char*)pool + pathAt;
+		object->FileSize = StateField64(record, 1);
+		object->ModifiedTime = (int64_t)StateField64(record, 3);
+		object->Fingerprint = StateField64(record, 5);
+		object->StartLink = SnapshotField(record, 15);
+		object->IsSobj = (SnapshotField(record, 16) & LINK_RECORD_IS_SOBJ) != 0;
+		object->Linkable = (SnapshotField(record, 16) & LINK_RECORD_LINKABLE) != 0;
+
+		object->Sections = (SectionWrite*)calloc((size_t)object->SectionCount + 1, sizeof(SectionWrite)); if (object->Sections == NULL) { puts("ArgLink error: cannot allocate for object->Sections of type SectionWrite*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+		for (int32_t i = 0; i < object->SectionCount; i++) {
+			const uint8_t* sectionRecord = sectionRecords + ((size_t)firstSection + (size_t)i) * LINK_RECORD_SECTION;
+			SectionWrite* section = &object->Sections[i];
+			section->Start = SnapshotField(sectionRecord, 0);
+			section->Offset = (int32_t)SnapshotField(sectionRecord, 1);
+			section->Size = SnapshotField(sectionRecord, 2);
+			section->Type = (int32_t)SnapshotField(sectionRecord, 3);
+			if (section->Type == 1) {
+				uint32_t at = SnapshotField(sectionRecord, 4);
+				if (at >= poolSize) { printf("ArgLink error: %s %s is damaged, source code line " STRINGIZE(__LINE__) "\n", kind, path); LinkExit(65); }
+				size_t length = strlen(pool + at);
+				section->ExternalPath = (char*)calloc(length + 1, sizeof(char)); if (section->ExternalPath == NULL) { puts("ArgLink error: cannot allocate for section->ExternalPath of type char*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+				memcpy(section->ExternalPath, pool + at, length);
+			}
+		}
+
+		object->PublicCapacity = object->PublicCount;
+		object->Publics = (PublicDef*)calloc(object->PublicCount + 1, sizeof(PublicDef)); if (object->Publics == NULL) { puts("ArgLink error: cannot allocate for object->Publics of type PublicDef*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+		for (size_t p = 0; p < object->PublicCount; p++) {
+			const uint8_t* publicRecord = publicRecords + ((size_t)firstPublic + p) * LINK_RECORD_PUBLIC;
+			PublicDef* def = &object->Publics[p];
+			def->Symbol = SnapshotField(publicRecord, 0);
+			if (def->Symbol >= counts->Symbols) { printf("ArgLink error: %s %s is damaged, source code line " STRINGIZE(__LINE__) "\n", kind, path); LinkExit(65); }
+			def->Name = link->Symbols[def->Symbol].Name;
+			def->Length = strlen(def->Name);
+			def->Hash = link->Symbols[def->Symbol].Hash;
+			def->Value = (int32_t)SnapshotField(publicRecord, 1);
+		}
+
+		object->TermCapacity = object->TermCount;
+		object->Terms = (RelocationTerm*)calloc(object->TermCount + 1, sizeof(RelocationTerm)); if (object->Terms == NULL) { puts("ArgLink error: cannot allocate for object->Terms of type RelocationTerm*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+		for (size_t t = 0; t < object->TermCount; t++) {
+			const uint8_t* termRecord = termRecords + ((size_t)firstTerm + t) * LINK_RECORD_TERM;
+			object->Terms[t].Check1 = termRecord[0];
+			object->Terms[t].Operation = termRecord[1];
+			object->Terms[t].Value = (int32_t)SnapshotField(termRecord, 1);
+		}
+
+		object->RelocationCapacity = object->RelocationCount;
+		object->Relocations = (Relocation*)calloc(object->RelocationCount + 1, sizeof(Relocation)); if (object->Relocations == NULL) { puts("ArgLink error: cannot allocate for object->Relocations of type Relocation*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+		for (size_t r = 0; r < object->RelocationCount; r++) {
+			const uint8_t* relocationRecord = relocationRecords + ((size_t)firstRelocation + r) * LINK_RECORD_RELOCATION;
+			Relocation* reloc = &object->Relocations[r];
+			reloc->Symbol = SnapshotField(relocationRecord, 0);
+			reloc->TermSymbol = SnapshotField(relocationRecord, 1);
+			reloc->FirstTerm = SnapshotField(relocationRecord, 4);
+			reloc->TermCount = SnapshotField(relocationRecord, 5);
+			if ((reloc->Symbol >= counts->Symbols) || (reloc->TermSymbol >= counts->Symbols) || ((uint64_t)reloc->FirstTerm + reloc->TermCount > object->TermCount)) {
+				printf("ArgLink error: %s %s is damaged, source code line " STRINGIZE(__LINE__) "\n", kind, path); LinkExit(65);
+			}
+			reloc->Position = SnapshotField(relocationRecord, 2);
+			reloc->Offset = (int32_t)SnapshotField(relocationRecord, 3);
+			reloc->Format = (uint8_t)SnapshotField(relocationRecord, 6);
+			reloc->Name = link->Symbols[reloc->Symbol].Name;
+			reloc->Secondary = (SnapshotField(relocationRecord, 6) & LINK_RECORD_SECONDARY) ? link->Symbols[reloc->TermSymbol].Name : NULL;
+		}
+	}
+	return link;
+}
+
+#pragma mark - Link snapshots
+// Objects and the final symbol table after step 2, with symbols resolved and data embedded,
+// so a ROM can be linked again without any object file. Little-endian, all fields 32-bit:
+// "ALSN", version and 3 zero bytes, then the counts of link records, the sizes of the string
+// pool and data blob, and reserved 0. The link records follow, then the data record of each
+// section, then the string pool and the data blob.
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_HEADER 44
+#define SNAPSHOT_DATA 8        // Offset and size in the data blob, 0 for a section of an external file
+
+void SaveLinkSnapshot(const char* path, const SymbolTable* link, const SobObject objects[], int32_t objectCount)
+{
+	StateWriter header, records, pool, data;
+	memset(&header, 0, sizeof(header)); memset(&records, 0, sizeof(records)); memset(&pool, 0, sizeof(pool)); memset(&data, 0, sizeof(data));
+	LinkRecordCounts counts = PutLinkRecords(&records, &pool, link, objects, objectCount);
+	for (int32_t o = 0; o < objectCount; o++) {
+		for (int32_t i = 0; i < objects[o].SectionCount; i++) {
+			const SectionWrite* section = &objects[o].Sections[i];
+			PutLEInt32(&records, (section->Type == 0) ? (int32_t)(uint32_t)data.Size : 0);
+			PutLEInt32(&records, (section->Type == 0) ? (int32_t)(uint32_t)section->DataSize : 0);
+			if (section->Type == 0) {
+				PutBytes(&data, section->Data, section->DataSize);
+			}
+		}
+	}
+
+	PutBytes(&header, "ALSN", 4);
+	PutByte(&header, SNAPSHOT_VERSION);
+	PutByte(&header, 0); PutByte(&header, 0); PutByte(&header, 0);
+	PutLinkRecordCounts(&header, &counts);
+	PutLEInt32(&header, (int32_t)(uint32_t)pool.Size);
+	PutLEInt32(&header, (int32_t)(uint32_t)data.Size);
+	PutLEInt32(&header, 0);
+
+	FILE* fileSnapshot = fopen(path, "wb"); if (fileSnapshot == NULL) { printf("ArgLink error: cannot open %s in Write mode, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(73); }; setvbuf(fileSnapshot, NULL, _IONBF, 0);
+	if ((fwrite(header.Bytes, 1, header.Size, fileSnapshot) != header.Size) || (fwrite(records.Bytes, 1, records.Size, fileSnapshot) != records.Size) ||
+		(fwrite(pool.Bytes, 1, pool.Size, fileSnapshot) != pool.Size) || (fwrite(data.Bytes, 1, data.Size, fileSnapshot) != data.Size)) {
+		printf("ArgLink error: writing %s failed, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(74);
+	}
+	fclose(fileSnapshot);
+	StatsWrote(header.Size + records.Size + pool.Size + data.Size, 4);
+	free(header.Bytes); free(records.Bytes); free(pool.Bytes); free(data.Bytes);
+}
+
+// Strings, paths and section data of a loaded snapshot are views into its mapped file
+typedef struct LinkSnapshot {
+	SobReader* Contents;
+	SobObject* Objects;
+	int32_t ObjectCount;
+	SymbolTable* Link;
+} LinkSnapshot;
+
+LinkSnapshot* LoadLinkSnapshot(const char* path)
+{
+	SobReader* fileSnapshot = SobReaderOpen(path);
+	const uint8_t* bytes = fileSnapshot->Bytes;
+	if ((fileSnapshot->Size < SNAPSHOT_HEADER) || (memcmp(bytes, "ALSN", 4) != 0) || (bytes[4] != SNAPSHOT_VERSION)) {
+		printf("ArgLink error: %s is not a version %d snapshot, source code line " STRINGIZE(__LINE__) "\n", path, SNAPSHOT_VERSION); LinkExit(65);
+	}
+	LinkRecordCounts counts = GetLinkRecordCounts(bytes);
+	uint32_t poolSize = SnapshotField(bytes, 8), dataSize = SnapshotField(bytes, 9);
+	uint64_t expected = SNAPSHOT_HEADER + LinkRecordsSize(&counts) + (uint64_t)counts.Sections * SNAPSHOT_DATA + poolSize + dataSize;
+	if ((expected != fileSnapshot->Size) || (counts.Objects > INT32_MAX) || ((poolSize > 0) && (bytes[expected - dataSize - 1] != '\0'))) {
+		printf("ArgLink error: snapshot %s is damaged, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(65);
+	}
+	const uint8_t* dataRecords = bytes + SNAPSHOT_HEADER + (size_t)LinkRecordsSize(&counts);
+	const char* pool = (const char*)(dataRecords + (size_t)counts.Sections * SNAPSHOT_DATA);
+	const uint8_t* data = (const uint8_t*)pool + poolSize;
+
+	LinkSnapshot* snapshot = (LinkSnapshot*)calloc(1, sizeof(LinkSnapshot)); if (snapshot == NULL) { puts("ArgLink error: cannot allocate for snapshot of type LinkSnapshot*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	snapshot->Contents = fileSnapshot;
+	snapshot->ObjectCount = (int32_t)counts.Objects;
+	snapshot->Objects = (SobObject*)calloc((size_t)counts.Objects + 1, sizeof(SobObject)); if (snapshot->Objects == NULL) { puts("ArgLink error: cannot allocate for snapshot->Objects of type SobObject*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	snapshot->Link = ReadLinkRecords(bytes + SNAPSHOT_HEADER, &counts, pool, poolSize, snapshot->Objects, "snapshot", path);
+
+	// Data records follow the sections in the order they were written
+	uint32_t s = 0;
+	for (uint32_t o = 0; o < counts.Objects; o++) {
+		for (int32_t i = 0; i < snapshot->Objects[o].SectionCount; i++, s++) {
+			SectionWrite* section = &snapshot->Objects[o].Sections[i];
+			if (s >= counts.Sections) { printf("ArgLink error: snapshot %s is damaged, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(65); }
+			if (section->Type == 0) {
+				uint32_t at = SnapshotField(dataRecords + (size_t)s * SNAPSHOT_DATA, 0);
+				section->DataSize = SnapshotField(dataRecords + (size_t)s * SNAPSHOT_DATA, 1);
+				if ((uint64_t)at + section->DataSize > dataSize) { printf("ArgLink error: snapshot %s is damaged, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(65); }
+				section->Data = data + at;
+			}
+		}
+	}
+	return snapshot;
+}
+
+#pragma mark - Symbol database
+// The final symbols, for debuggers and symbolizers, in a file that is used mapped as is.
+// Little-endian, all fields 32-bit: "ALSD", version and 3 zero bytes, then the symbol count
+// and the string pool size. The symbol records follow sorted by name (bytewise), then the
+// address index sorted by value then name, then the string pool.
+#define SYMBOL_DB_VERSION 1
+#define SYMBOL_DB_HEADER 16
+#define SYMBOL_DB_SYMBOL 12    // Name, origin file, value
+#define SYMBOL_DB_ADDRESS 8    // Value, symbol record
+
+int CompareSymbolNames(const void* left, const void* right)
+{
+	return strcmp((*(const LinkData* const*)left)->Name, (*(const LinkData* const*)right)->Name);
+}
+
+int CompareSymbolValues(const void* left, const void* right)
+{
+	uint32_t leftValue = (uint32_t)(*(const LinkData* const*)left)->Value;
+	uint32_t rightValue = (uint32_t)(*(const LinkData* const*)right)->Value;
+	if (leftValue != rightValue) {
+		return (leftValue < rightValue) ? -1 : 1;
+	}
+	return CompareSymbolNames(left, right);
+}
+
+// The one sort path for -S, -X and the symbol database, as the original ArgLink sorted by name
+const LinkData** SortedSymbols(const SymbolTable* link, bool byValue)
+{
+	const LinkData** sorted = (const LinkData**)calloc(link->Count + 1, sizeof(LinkData*)); if (sorted == NULL) { puts("ArgLink error: cannot allocate for sorted of type const LinkData**, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	for (size_t id = 0; id < link->Count; id++) {
+		sorted[id] = &link->Symbols[id];
+	}
+	qsort(sorted, link->Count, sizeof(LinkData*), byValue ? CompareSymbolValues : CompareSymbolNames);
+	return sorted;
+}
+
+void SaveSymbolDatabase(const char* path, const SymbolTable* link)
+{
+	StateWriter records, pool;
+	memset(&records, 0, sizeof(records)); memset(&pool, 0, sizeof(pool));
+
+	// Origin paths are pooled once; the index maps a path to its offset + 1
+	ht* origins = ht_create(64);
+	const LinkData** byName = SortedSymbols(link, false);
+	for (size_t i = 0; i < link->Count; i++) {
+		const LinkData* symbol = byName[i];
+		void* origin = ht_get(origins, symbol->Origin);
+		if (origin == NULL) {
+			origin = SymbolRef(PutPooled(&pool, symbol->Origin, strlen(symbol->Origin)));
+			ht_set(origins, symbol->Origin, origin);
+		}
+		PutLEInt32(&records, (int32_t)PutPooled(&pool, symbol->Name, strlen(symbol->Name)));
+		PutLEInt32(&records, (int32_t)SymbolId(origin));
+		PutLEInt32(&records, symbol->Value);
+	}
+	ht_destroy(origins);
+
+	// Records are found again from the value order by their rank in the name order
+	const LinkData** byValue = SortedSymbols(link, true);
+	for (size_t i = 0; i < link->Count; i++) {
+		const LinkData** found = (const LinkData**)bsearch(&byValue[i], byName, link->Count, sizeof(LinkData*), CompareSymbolNames);
+		PutLEInt32(&records, byValue[i]->Value);
+		PutLEInt32(&records, (int32_t)(found - byName));
+	}
+	free(byName); free(byValue);
+
+	StateWriter header;
+	memset(&header, 0, sizeof(header));
+	PutBytes(&header, "ALSD", 4);
+	PutByte(&header, SYMBOL_DB_VERSION);
+	PutByte(&header, 0); PutByte(&header, 0); PutByte(&header, 0);
+	PutLEInt32(&header, (int32_t)link->Count);
+	PutLEInt32(&header, (int32_t)(uint32_t)pool.Size);
+
+	FILE* fileDatabase = fopen(path, "wb"); if (fileDatabase == NULL) { printf("ArgLink error: cannot open %s in Write mode, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(73); }; setvbuf(fileDatabase, NULL, _IONBF, 0);
+	if ((fwrite(header.Bytes, 1, header.Size, fileDatabase) != header.Size) || (fwrite(records.Bytes, 1, records.Size, fileDatabase) != records.Size) ||
+		(fwrite(pool.Bytes, 1, pool.Size, fileDatabase) != pool.Size)) {
+		printf("ArgLink error: writing %s failed, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(74);
+	}
+	fclose(fileDatabase);
+	StatsWrote(header.Size + records.Size + pool.Size, 3);
+	free(header.Bytes); free(records.Bytes); free(pool.Bytes);
+}
+
+// A mapped database; names and paths are views into it
+typedef struct SymbolDatabase {
+	SobReader* Contents;
+	const uint8_t* Symbols;
+	const uint8_t* Addresses;
+	const char* Pool;
+	uint32_t Count;
+} SymbolDatabase;
+
+SymbolDatabase* OpenSymbolDatabase(const char* path)
+{
+	SobReader* fileDatabase = SobReaderOpen(path);
+	const uint8_t* bytes = fileDatabase->Bytes;
+	if ((fileDatabase->Size < SYMBOL_DB_HEADER) || (memcmp(bytes, "ALSD", 4) != 0) || (bytes[4] != SYMBOL_DB_VERSION)) {
+		printf("ArgLink error: %s is not a version %d symbol database, source code line " STRINGIZE(__LINE__) "\n", path, SYMBOL_DB_VERSION); LinkExit(65);
+	}
+	uint32_t count = SnapshotField(bytes, 2), poolSize = SnapshotField(bytes, 3);
+	uint64_t expected = SYMBOL_DB_HEADER + (uint64_t)count * (SYMBOL_DB_SYMBOL + SYMBOL_DB_ADDRESS) + poolSize;
+	if ((expected != fileDatabase->Size) || ((poolSize > 0) && (bytes[expected - 1] != '\0'))) {
+		printf("ArgLink error: symbol database %s is damaged, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(65);
+	}
+
+	SymbolDatabase* database = (SymbolDatabase*)calloc(1, sizeof(SymbolDatabase)); if (database == NULL) { puts("ArgLink error: cannot allocate for database of type SymbolDatabase*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	database->Contents = fileDatabase;
+	database->Count = count;
+	database->Symbols = bytes + SYMBOL_DB_HEADER;
+	database->Addresses = database->Symbols + (size_t)count * SYMBOL_DB_SYMBOL;
+	database->Pool = (const char*)(database->Addresses + (size_t)count * SYMBOL_DB_ADDRESS);
+	for (uint32_t i = 0; i < count; i++) {
+		const uint8_t* record = database->Symbols + (size_t)i * SYMBOL_DB_SYMBOL;
+		if ((SnapshotField(record, 0) >= poolSize) || (SnapshotField(record, 1) >= poolSize) ||
+			(SnapshotField(database->Addresses + (size_t)i * SYMBOL_DB_ADDRESS, 1) >= count)) {
+			printf("ArgLink error: symbol database %s is damaged, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(65);
+		}
+	}
+	return database;
+}
+
+void CloseSymbolDatabase(SymbolDatabase* database)
+{
+	SobReaderClose(database->Contents);
+	free(database);
+}
+
+// Same line as -S; a nearest symbol below the address also shows the distance to it
+void OutputDatabaseSymbol(const SymbolDatabase* database, uint32_t index, const char* query, uint32_t address)
+{
+	const uint8_t* record = database->Symbols + (size_t)index * SYMBOL_DB_SYMBOL;
+	uint32_t value = SnapshotField(record, 2);
+	printf("FILE: %-17s -- SYMBOL: %-30s -- VALUE: %6" PRIX32, database->Pool + SnapshotField(record, 1), database->Pool + SnapshotField(record, 0), value);
+	if ((query != NULL) && (address != value)) {
+		printf(" -- %s = +%" PRIX32, query, address - value);
+	}
+	putchar('\n');
+}
+
+// First entry of the address index whose value is at least address
+uint32_t LowerAddressBound(const SymbolDatabase* database, uint32_t address)
+{
+	uint32_t low = 0, high = database->Count;
+	while (low < high) {
+		uint32_t middle = low + (high - low) / 2;
+		if (SnapshotField(database->Addresses + (size_t)middle * SYMBOL_DB_ADDRESS, 0) < address) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	return low;
+}
+
+bool ParseAddress(const char* text, uint32_t* address)
+{
+	char* end;
+	unsigned long parsed = strtoul(text, &end, 16);
+	*address = (uint32_t)parsed;
+	return (end != text) && (*end == '\0') && (parsed <= UINT32_MAX);
+}
+
+// A query is a symbol name, @address for the nearest symbol at or below it, or
+// @low-high for every symbol in that range (hexadecimal, both ends included).
+// Returns false when nothing matched.
+bool LookupSymbol(const SymbolDatabase* database, char* query)
+{
+	if (query[0] != '@') {
+		uint32_t low = 0, high = database->Count;
+		while (low < high) {
+			uint32_t middle = low + (high - low) / 2;
+			int order = strcmp(database->Pool + SnapshotField(database->Symbols + (size_t)middle * SYMBOL_DB_SYMBOL, 0), query);
+			if (order == 0) {
+				OutputDatabaseSymbol(database, middle, NULL, 0);
+				return true;
+			} else if (order < 0) {
+				low = middle + 1;
+			} else {
+				high = middle;
+			}
+		}
+		printf("SYMBOL: %s -- NOT FOUND\n", query);
+		return false;
+	}
+
+	uint32_t first, last;
+	char* dash = strchr(query + 1, '-');
+	if (dash != NULL) {
+		*dash = '\0';
+	}
+	bool valid = ParseAddress(query + 1, &first) && ((dash == NULL) || ParseAddress(dash + 1, &last));
+	if (dash != NULL) {
+		*dash = '-';
+	}
+	if (!valid) {
+		printf("ArgLink warning: cannot read address in query %s.\n", query);
+		return false;
+	}
+
+	if (dash != NULL) {
+		bool found = false;
+		for (uint32_t i = LowerAddressBound(database, first); i < database->Count; i++) {
+			const uint8_t* entry = database->Addresses + (size_t)i * SYMBOL_DB_ADDRESS;
+			if (SnapshotField(entry, 0) > last) {
+				break;
+			}
+			OutputDatabaseSymbol(database, SnapshotField(entry, 1), NULL, 0);
+			found = true;
+		}
+		if (!found) {
+			printf("RANGE: %s -- NOT FOUND\n", query + 1);
+		}
+		return found;
+	}
+
+	// The last value at or below the address, and of the symbols sharing it the first by name
+	uint32_t i = LowerAddressBound(database, first);
+	if ((i >= database->Count) || (SnapshotField(database->Addresses + (size_t)i * SYMBOL_DB_ADDRESS, 0) != first)) {
+		if (i == 0) {
+			printf("ADDRESS: %s -- NOT FOUND\n", query + 1);
+			return false;
+		}
+		i = LowerAddressBound(database, SnapshotField(database->Addresses + (size_t)(i - 1) * SYMBOL_DB_ADDRESS, 0));
+	}
+	OutputDatabaseSymbol(database, SnapshotField(database->Addresses + (size_t)i * SYMBOL_DB_ADDRESS, 1), query + 1, first);
+	return true;
+}
+
+// --lookup: answers the queries given on the command line, or else one per line on standard input
+int32_t RunLookups(const char* path, char* queries[], int32_t queryCount)
+{
+	SymbolDatabase* database = OpenSymbolDatabase(path);
+	bool allFound = true;
+	for (int32_t q = 0; q < queryCount; q++) {
+		allFound = LookupSymbol(database, queries[q]) && allFound;
+	}
+	if (queryCount == 0) {
+		char line[1024];
+		while (fgets(line, sizeof(line), stdin) != NULL) {
+			line[strcspn(line, "\r\n")] = '\0';
+			if (line[0] != '\0') {
+				allFound = LookupSymbol(database, line) && allFound;
+			}
+		}
+	}
+	CloseSymbolDatabase(database);
+	return allFound ? (int32_t)Success : (int32_t)BadInputData;
+}
+
+#pragma mark - Debugger MAP file
+// -Z: sections by ROM offset, then publics by address, as text next to the ROM.
+// Both lists are sorted with a stable radix sort, one pass per byte of the largest key
+// (three for 24-bit addresses), so objects and symbols keep definition order on ties.
+#define MAP_BUFFER_SIZE (1024 * 1024)
+
+// Returns the indexes 0 to count - 1 ordered by key
+uint32_t* RadixSortByKey(const uint32_t keys[], uint32_t count)
+{
+	uint32_t* order = (uint32_t*)calloc((size_t)count + 1, sizeof(uint32_t)); if (order == NULL) { puts("ArgLink error: cannot allocate for order of type uint32_t*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	uint32_t* sorted = (uint32_t*)calloc((size_t)count + 1, sizeof(uint32_t)); if (sorted == NULL) { puts("ArgLink error: cannot allocate for sorted of type uint32_t*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	uint32_t all = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		order[i] = i;
+		all |= keys[i];
+	}
+	for (uint32_t shift = 0; (shift < 32) && ((all >> shift) != 0); shift += 8) {
+		size_t counts[257];
+		memset(counts, 0, sizeof(counts));
+		for (uint32_t i = 0; i < count; i++) {
+			counts[((keys[i] >> shift) & 0xFF) + 1]++;
+		}
+		for (size_t b = 1; b < 257; b++) {
+			counts[b] += counts[b - 1];
+		}
+		for (uint32_t i = 0; i < count; i++) {
+			sorted[counts[(keys[order[i]] >> shift) & 0xFF]++] = order[i];
+		}
+		uint32_t* swap = order; order = sorted; sorted = swap;
+	}
+	free(sorted);
+	return order;
+}
+
+// The MAP file is named after the ROM, with its extension replaced
+char* MapPathFor(const char* romFile)
+{
+	char* extension = ExtensionOf(romFile);
+	size_t length = (extension != NULL) ? (size_t)(extension - romFile) : strlen(romFile);
+	char* mapPath = (char*)calloc(length + 5, sizeof(char)); if (mapPath == NULL) { puts("ArgLink error: cannot allocate for mapPath of type char*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	memcpy(mapPath, romFile, length); memcpy(mapPath + length, ".map", 4);
+	return mapPath;
+}
+
+void WriteMapFile(const char* path, const char* romFile, const SymbolTable* link, const SobObject objects[], int32_t objectCount)
+{
+	FILE* fileMap = fopen(path, "wb"); if (fileMap == NULL) { printf("ArgLink error: cannot open %s in Write mode, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(73); }
+	char* fileMapBuffer = (char*)malloc(MAP_BUFFER_SIZE); if (fileMapBuffer == NULL) { puts("ArgLink error: cannot allocate for fileMapBuffer of type char*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	setvbuf(fileMap, fileMapBuffer, _IOFBF, MAP_BUFFER_SIZE);
+	fprintf(fileMap, "ArgLink MAP file for %s\n\nSections:\n  OFFSET    SIZE  TYPE      FILE\n", romFile);
+
+	uint32_t sectionCount = 0;
+	for (int32_t o = 0; o < objectCount; o++) {
+		sectionCount += (uint32_t)objects[o].SectionCount;
+	}
+	const SectionWrite** sections = (const SectionWrite**)calloc((size_t)sectionCount + 1, sizeof(SectionWrite*)); if (sections == NULL) { puts("ArgLink error: cannot allocate for sections of type const SectionWrite**, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	const char** sectionPaths = (const char**)calloc((size_t)sectionCount + 1, sizeof(char*)); if (sectionPaths == NULL) { puts("ArgLink error: cannot allocate for sectionPaths of type const char**, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	uint32_t* keys = (uint32_t*)calloc((size_t)((sectionCount > link->Count) ? sectionCount : link->Count) + 1, sizeof(uint32_t)); if (keys == NULL) { puts("ArgLink error: cannot allocate for keys of type uint32_t*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	uint32_t k = 0;
+	for (int32_t o = 0; o < objectCount; o++) {
+		for (int32_t i = 0; i < objects[o].SectionCount; i++, k++) {
+			sections[k] = &objects[o].Sections[i];
+			sectionPaths[k] = objects[o].Path;
+			keys[k] = (uint32_t)sections[k]->Offset;
+		}
+	}
+	uint32_t* order = RadixSortByKey(keys, sectionCount);
+	for (uint32_t i = 0; i < sectionCount; i++) {
+		const SectionWrite* section = sections[order[i]];
+		if (section->Type == 1) {
+			fprintf(fileMap, "  %06" PRIX32 "  %06" PRIX64 "  external  %s (%s)\n", (uint32_t)section->Offset, (uint64_t)section->Size, sectionPaths[order[i]], section->ExternalPath);
+		} else {
+			fprintf(fileMap, "  %06" PRIX32 "  %06" PRIX64 "  data      %s\n", (uint32_t)section->Offset, (uint64_t)section->Size, sectionPaths[order[i]]);
+		}
+	}
+	free(order); free(sections); free(sectionPaths);
+
+	fputs("\nPublics by address:\n  VALUE   SYMBOL                          FILE\n", fileMap);
+	for (size_t id = 0; id < link->Count; id++) {
+		keys[id] = (uint32_t)link->Symbols[id].Value;
+	}
+	order = RadixSortByKey(keys, (uint32_t)link->Count);
+	for (size_t i = 0; i < link->Count; i++) {
+		const LinkData* symbol = &link->Symbols[order[i]];
+		fprintf(fileMap, "  %06" PRIX32 "  %-30s  %s\n", (uint32_t)symbol->Value, symbol->Name, symbol->Origin);
+	}
+	free(order); free(keys);
+
+	if (s_stats != NULL) {
+		StatsWrote((size_t)ftell(fileMap), 1);
+	}
+	if (fclose(fileMap) != 0) { printf("ArgLink error: writing %s failed, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(74); }
+	free(fileMapBuffer);
+}
+
+#pragma mark - ROM layout
+// Every section written to the ROM as an interval, sorted once by ROM offset: overlaps are
+// then found in one sweep, and the -L and -R reports and the free-space bitmap are built
+// from the same index.
+#define LAYOUT_BANK_SIZE 0x8000
+
+typedef struct LayoutBlock {
+	uint32_t Start;
+	uint32_t End;         // Exclusive
+	int32_t Object;
+	int32_t Section;
+} LayoutBlock;
+
+typedef struct RomLayout {
+	const SobObject* Objects;
+	LayoutBlock* Blocks;  // By Start, then in command-line order
+	uint32_t Count;
+} RomLayout;
+
+RomLayout* RomLayoutFor(const SobObject objects[], int32_t objectCount)
+{
+	uint32_t sectionCount = 0;
+	for (int32_t o = 0; o < objectCount; o++) {
+		sectionCount += (uint32_t)objects[o].SectionCount;
+	}
+	LayoutBlock* unsorted = (LayoutBlock*)calloc((size_t)sectionCount + 1, sizeof(LayoutBlock)); if (unsorted == NULL) { puts("ArgLink error: cannot allocate for unsorted of type LayoutBlock*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	uint32_t* keys = (uint32_t*)calloc((size_t)sectionCount + 1, sizeof(uint32_t)); if (keys == NULL) { puts("ArgLink error: cannot allocate for keys of type uint32_t*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	uint32_t count = 0;
+	for (int32_t o = 0; o < objectCount; o++) {
+		for (int32_t i = 0; i < objects[o].SectionCount; i++) {
+			const SectionWrite* section = &objects[o].Sections[i];
+			if ((section->Offset < 0) || (section->Size == 0)) {
+				continue;
+			}
+			LayoutBlock* block = &unsorted[count];
+			block->Start = (uint32_t)section->Offset;
+			block->End = ((uint64_t)block->Start + section->Size > UINT32_MAX) ? UINT32_MAX : (uint32_t)(block->Start + section->Size);
+			block->Object = o;
+			block->Section = i;
+			keys[count++] = block->Start;
+		}
+	}
+
+	uint32_t* order = RadixSortByKey(keys, count);
+	RomLayout* layout = (RomLayout*)calloc(1, sizeof(RomLayout)); if (layout == NULL) { puts("ArgLink error: cannot allocate for layout of type RomLayout*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	layout->Objects = objects;
+	layout->Count = count;
+	layout->Blocks = (LayoutBlock*)calloc((size_t)count + 1, sizeof(LayoutBlock)); if (layout->Blocks == NULL) { puts("ArgLink error: cannot allocate for layout->Blocks of type LayoutBlock*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	for (uint32_t i = 0; i < count; i++) {
+		layout->Blocks[i] = unsorted[order[i]];
+	}
+	free(order); free(keys); free(unsorted);
+	return layout;
+}
+
+void RomLayoutDestroy(RomLayout* layout)
+{
+	free(layout->Blocks);
+	free(layout);
+}
+
+// Each section starting before the furthest end seen so far overlaps the section with that
+// end; it is reported once, against that section. Sections are written in command-line
+// order, so the one of the later object (or later in the same object) is the overwriter.
+// Returns the number of overlapping sections.
+uint32_t ReportLayoutOverlaps(const RomLayout* layout)
+{
+	uint32_t overlaps = 0;
+	uint32_t reach = 0;
+	for (uint32_t i = 1; i < layout->Count; i++) {
+		const LayoutBlock* block = &layout->Blocks[i];
+		const LayoutBlock* furthest = &layout->Blocks[reach];
+		if (block->Start < furthest->End) {
+			uint32_t end = (block->End < furthest->End) ? block->End : furthest->End;
+			bool blockLater = (block->Object > furthest->Object) || ((block->Object == furthest->Object) && (block->Section > furthest->Section));
+			const LayoutBlock* writer = blockLater ? block : furthest;
+			const LayoutBlock* written = blockLater ? furthest : block;
+			printf("ArgLink warning: section %" PRId32 " of %s overwrites section %" PRId32 " of %s at ROM offset %" PRIX32 " to %" PRIX32 "\n",
+				writer->Section, layout->Objects[writer->Object].Path, written->Section, layout->Objects[written->Object].Path, block->Start, end - 1);
+			overlaps++;
+		}
+		if (block->End > furthest->End) {
+			reach = i;
+		}
+	}
+	return overlaps;
+}
+
+// One bit per ROM byte, least significant first, set where no section writes
+uint8_t* FreeSpaceBitmap(const RomLayout* layout, size_t romSize)
+{
+	size_t bitmapSize = (romSize + 7) / 8;
+	uint8_t* bitmap = (uint8_t*)malloc(bitmapSize + 1); if (bitmap == NULL) { puts("ArgLink error: cannot allocate for bitmap of type uint8_t*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	memset(bitmap, 0xFF, bitmapSize);
+	if ((romSize % 8) != 0) {
+		bitmap[bitmapSize - 1] = (uint8_t)((1u << (romSize % 8)) - 1);
+	}
+	// Sorted blocks let each stretch of bytes be cleared once, however many sections cover it
+	size_t cleared = 0;
+	for (uint32_t i = 0; i < layout->Count; i++) {
+		size_t start = (layout->Blocks[i].Start > cleared) ? layout->Blocks[i].Start : cleared;
+		size_t end = (layout->Blocks[i].End < romSize) ? layout->Blocks[i].End : romSize;
+		for (size_t at = start; at < end; ) {
+			if (((at % 8) == 0) && (at + 8 <= end)) {
+				size_t bytes = (end - at) / 8;
+				memset(bitmap + at / 8, 0, bytes);
+				at += bytes * 8;
+			} else {
+				bitmap[at / 8] &= (uint8_t)~(1u << (at % 8));
+				at++;
+			}
+		}
+		if (end > cleared) {
+			cleared = end;
+		}
+	}
+	return bitmap;
+}
+
+void SaveFreeSpaceBitmap(const char* path, const RomLayout* layout, size_t romSize)
+{
+	uint8_t* bitmap = FreeSpaceBitmap(layout, romSize);
+	size_t bitmapSize = (romSize + 7) / 8;
+	FILE* fileBitmap = fopen(path, "wb"); if (fileBitmap == NULL) { printf("ArgLink error: cannot open %s in Write mode, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(73); }; setvbuf(fileBitmap, NULL, _IONBF, 0);
+	if (fwrite(bitmap, 1, bitmapSize, fileBitmap) != bitmapSize) { printf("ArgLink error: writing %s failed, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(74); }
+	fclose(fileBitmap);
+	StatsWrote(bitmapSize, 1);
+	free(bitmap);
+}
+
+// -R: the used blocks, each a run of sections without free space between them
+void OutputRomBlocks(const RomLayout* layout)
+{
+	puts("ROM Blocks:");
+	for (uint32_t first = 0; first < layout->Count; ) {
+		uint32_t end = layout->Blocks[first].End;
+		uint32_t last = first + 1;
+		while ((last < layout->Count) && (layout->Blocks[last].Start <= end)) {
+			if (layout->Blocks[last].End > end) {
+				end = layout->Blocks[last].End;
+			}
+			last++;
+		}
+		printf("BLOCK: %06" PRIX32 "-%06" PRIX32 " -- SIZE: %6" PRIX32 " -- SECTIONS: %" PRIu32 "\n", layout->Blocks[first].Start, end - 1, end - layout->Blocks[first].Start, last - first);
+		first = last;
+	}
+}
+
+// -L: use of each 32 KiB bank of the first sizeKiB of the ROM, one mark per KiB
+// ('#' full, '+' partly used, '.' free)
+void OutputRomLayout(const RomLayout* layout, size_t sizeKiB)
+{
+	size_t romSize = sizeKiB * 1024;
+	uint8_t* bitmap = FreeSpaceBitmap(layout, romSize);
+	size_t totalUsed = 0;
+	puts("ROM Layout:");
+	for (size_t bank = 0; bank * LAYOUT_BANK_SIZE < romSize; bank++) {
+		char marks[LAYOUT_BANK_SIZE / 1024 + 1];
+		size_t bankUsed = 0;
+		size_t kib = 0;
+		for (; (kib < LAYOUT_BANK_SIZE / 1024) && (bank * LAYOUT_BANK_SIZE + kib * 1024 < romSize); kib++) {
+			size_t used = 0;
+			for (size_t b = 0; b < 128; b++) {
+				uint8_t bits = bitmap[(bank * LAYOUT_BANK_SIZE + kib * 1024) / 8 + b];
+				for (; bits != 0; bits &= (uint8_t)(bits - 1)) {
+					used++;
+				}
+			}
+			used = 1024 - used;
+			marks[kib] = (used == 1024) ? '#' : ((used > 0) ? '+' : '.');
+			bankUsed += used;
+		}
+		marks[kib] = '\0';
+		printf("BANK %02" PRIXPTR ": %s %6" PRIuPTR " byte(s) used\n", bank, marks, bankUsed);
+		totalUsed += bankUsed;
+	}
+	printf("| Used: %" PRIuPTR " byte(s)\tFree: %" PRIuPTR " byte(s) |\n", totalUsed, romSize - totalUsed);
+	free(bitmap);
+}
+
+#pragma mark - Incremental link state
+// A link session is what a link leaves for the next one: its objects, symbol table, ROM and
+// sorted patches. --incremental keeps it in a state file between runs. A relink checks the
+// sizes and times of the files first and hashes only those that differ; objects whose
+// contents changed are parsed again, relocations elsewhere are evaluated again only when a
+// symbol they use moved, and only the ROM bytes under changed sections, patches and external
+// files are rebuilt. What a relink cannot redo exactly as a full link would (objects removed
+// or reordered, unresolved symbols, writes out of range) leaves the session as it was, and
+// a full link follows.
+//
+// State file, little-endian, all fields 32-bit: "ALST", version and 3 zero bytes, then the
+// counts of link records, patches and external files, the string pool size, the ROM size,
+// the overlap count and reserved 0. The link records follow, then the patch and external
+// file records, then the string pool and the ROM.
+#define LINK_STATE_VERSION 2
+#define LINK_STATE_HEADER 56
+#define LINK_STATE_PATCH 20      // Start, value, width, object, relocation
+#define LINK_STATE_EXTERNAL 20   // Path, size and time (64-bit)
+#define NO_SYMBOL UINT32_MAX
+
+// Objects of a session keep no file open: their names are those interned in the symbol
+// table, and section data is mapped again only where ROM bytes are rebuilt
+typedef struct LinkSession {
+	SobObject* Objects;
+	int32_t ObjectCount;
+	SymbolTable* Link;
+	RomImage* Rom;
+	PatchIndex Patches;
+	ht* Externals;         // External files read, with their sizes and times
+	SobReader* Contents;   // The state file it was loaded from, which holds the object paths, or NULL
+	bool Unsaved;          // Changed since it was loaded or saved
+	bool Changing;         // While a relink is committed, which an error would leave halfway
+} LinkSession;
+
+void FingerprintObjectWork(void* objects, int32_t index)
+{
+	SobObject* object = &((SobObject*)objects)[index];
+	if (object->Contents == NULL) {
+		object->Contents = SobReaderOpen(object->Path);
+	}
+	object->FileSize = object->Contents->Size;
+	object->ModifiedTime = object->Contents->ModifiedTime;
+	object->Fingerprint = ht_hash((const char*)object->Contents->Bytes, object->Contents->Size);
+}
+
+// Points the names of an object at those of the symbol table, which outlive its file
+void InternObjectNames(SobObject* object, const SymbolTable* link)
+{
+	for (size_t p = 0; p < object->PublicCount; p++) {
+		object->Publics[p].Name = link->Symbols[object->Publics[p].Symbol].Name;
+	}
+	for (size_t r = 0; r < object->RelocationCount; r++) {
+		Relocation* reloc = &object->Relocations[r];
+		reloc->Name = link->Symbols[reloc->Symbol].Name;
+		if (reloc->Secondary != NULL) {
+			reloc->Secondary = link->Symbols[reloc->TermSymbol].Name;
+		}
+	}
+}
+
+// Closes the object file; MapObjectData opens it again when section data is needed
+void ReleaseObjectData(SobObject* object)
+{
+	if (object->Contents != NULL) {
+		SobReaderClose(object->Contents);
+		object->Contents = NULL;
+	}
+	for (int32_t i = 0; i < object->SectionCount; i++) {
+		object->Sections[i].Data = NULL;
+	}
+}
+
+// The file is unchanged since it was parsed, so section data is where it was then
+void MapObjectData(SobObject* object)
+{
+	if (object->Contents != NULL) {
+		return;
+	}
+	object->Contents = SobReaderOpen(object->Path);
+	size_t fileSize = object->Contents->Size;
+	for (int32_t i = 0; i < object->SectionCount; i++) {
+		SectionWrite* section = &object->Sections[i];
+		if (section->Type == 0) {
+			size_t start = (size_t)section->Start + 9;
+			size_t available = (start < fileSize) ? fileSize - start : 0;
+			section->DataSize = (section->Size < available) ? section->Size : available;
+			section->Data = object->Contents->Bytes + ((start < fileSize) ? start : fileSize);
+		}
+	}
+}
+
+// Takes over what a full link built, for the next link to start from
+LinkSession* LinkSessionCreate(SobObject objects[], int32_t objectCount, SymbolTable* link, RomImage* rom, PatchIndex patches, ht* externals)
+{
+	LinkSession* session = (LinkSession*)calloc(1, sizeof(LinkSession)); if (session == NULL) { puts("ArgLink error: cannot allocate for session of type LinkSession*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	// Non-SOBJ objects were closed once merged, and are opened again
+	RunOnWorkers(s_jobs, objectCount, FingerprintObjectWork, objects);
+	for (int32_t o = 0; o < objectCount; o++) {
+		InternObjectNames(&objects[o], link);
+		ReleaseObjectData(&objects[o]);
+	}
+	ReleaseExternalFiles(externals);
+	session->Objects = objects;
+	session->ObjectCount = objectCount;
+	session->Link = link;
+	session->Rom = rom;
+	session->Patches = patches;
+	session->Externals = externals;
+	session->Unsaved = true;
+	return session;
+}
+
+void LinkSessionDestroy(LinkSession* session)
+{
+	for (int32_t o = 0; o < session->ObjectCount; o++) {
+		ReleaseObjectData(&session->Objects[o]);
+		FreeParsedObject(&session->Objects[o]);
+	}
+	free(session->Objects);
+	SymbolTableDestroy(session->Link);
+	RomImageDestroy(session->Rom);
+	free(session->Patches.Records);
+	DestroyExternalFiles(session->Externals);
+	if (session->Contents != NULL) {
+		SobReaderClose(session->Contents);
+	}
+	free(session);
+}
+
+// Writes the whole state; returns false when writing failed
+bool PutLinkState(FILE* destination, const LinkSession* session)
+{
+	StateWriter header, records, pool;
+	memset(&header, 0, sizeof(header)); memset(&records, 0, sizeof(records)); memset(&pool, 0, sizeof(pool));
+	LinkRecordCounts counts = PutLinkRecords(&records, &pool, session->Link, session->Objects, session->ObjectCount);
+	ReserveBytes(&records, session->Patches.Count * LINK_STATE_PATCH + ht_length(session->Externals) * LINK_STATE_EXTERNAL);
+	for (size_t i = 0; i < session->Patches.Count; i++) {
+		const PatchRecord* patch = &session->Patches.Records[i];
+		PutLEInt32(&records, (int32_t)patch->Start);
+		PutLEInt32(&records, patch->Value);
+		PutLEInt32(&records, patch->Width);
+		PutLEInt32(&records, patch->Object);
+		PutLEInt32(&records, (int32_t)patch->Relocation);
+	}
+	hti kvp = ht_iterator(session->Externals); while (ht_next(&kvp)) {
+		const ExternalFile* cached = (const ExternalFile*)kvp.value;
+		PutLEInt32(&records, (int32_t)PutPooled(&pool, kvp.key, strlen(kvp.key)));
+		PutLEInt64(&records, (uint64_t)cached->FileSize);
+		PutLEInt64(&records, (uint64_t)cached->ModifiedTime);
+	}
+
+	PutBytes(&header, "ALST", 4);
+	PutByte(&header, LINK_STATE_VERSION);
+	PutByte(&header, 0); PutByte(&header, 0); PutByte(&header, 0);
+	PutLinkRecordCounts(&header, &counts);
+	PutLEInt32(&header, (int32_t)session->Patches.Count);
+	PutLEInt32(&header, (int32_t)ht_length(session->Externals));
+	PutLEInt32(&header, (int32_t)(uint32_t)pool.Size);
+	PutLEInt32(&header, (int32_t)(uint32_t)session->Rom->Size);
+	PutLEInt32(&header, (int32_t)session->Patches.Overlaps);
+	PutLEInt32(&header, 0);
+
+	bool wrote = (fwrite(header.Bytes, 1, header.Size, destination) == header.Size) && (fwrite(records.Bytes, 1, records.Size, destination) == records.Size) &&
+		(fwrite(pool.Bytes, 1, pool.Size, destination) == pool.Size) && (fwrite(session->Rom->Bytes, 1, session->Rom->Size, destination) == session->Rom->Size);
+	StatsWrote(header.Size + records.Size + pool.Size + session->Rom->Size, 4);
+	free(header.Bytes); free(records.Bytes); free(pool.Bytes);
+	return wrote;
+}
+
+// Written to a temporary file first, so an interrupted link never leaves a damaged state
+void SaveLinkState(const char* path, const LinkSession* session)
+{
+	size_t pathLength = strlen(path);
+	char* temporary = (char*)calloc(pathLength + 5, sizeof(char)); if (temporary == NULL) { puts("ArgLink error: cannot allocate for temporary of type char*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	memcpy(temporary, path, pathLength); memcpy(temporary + pathLength, ".tmp", 4);
+	FILE* fileState = fopen(temporary, "wb"); if (fileState == NULL) { printf("ArgLink error: cannot open %s in Write mode, source code line " STRINGIZE(__LINE__) "\n", temporary); LinkExit(73); }; setvbuf(fileState, NULL, _IONBF, 0);
+	if (!PutLinkState(fileState, session)) { printf("ArgLink error: writing %s failed, source code line " STRINGIZE(__LINE__) "\n", temporary); LinkExit(74); }
+	fclose(fileState);
+	// Windows does not replace an existing file on rename
+	remove(path);
+	if (rename(temporary, path) != 0) { printf("ArgLink error: cannot rename %s to %s, source code line " STRINGIZE(__LINE__) "\n", temporary, path); LinkExit(73); }
+	free(temporary);
+}
+
+// Takes over fileState; path only names it in messages. Returns NULL for a state from
+// another version, which a full link then replaces.
+LinkSession* ReadLinkState(SobReader* fileState, const char* path)
+{
+	const uint8_t* bytes = fileState->Bytes;
+	if ((fileState->Size < LINK_STATE_HEADER) || (memcmp(bytes, "ALST", 4) != 0) || (bytes[4] != LINK_STATE_VERSION)) {
+		printf("ArgLink warning: ignoring link state %s from another version.\n", path);
+		SobReaderClose(fileState);
+		return NULL;
+	}
+	LinkRecordCounts counts = GetLinkRecordCounts(bytes);
+	uint32_t patchCount = SnapshotField(bytes, 8), externalCount = SnapshotField(bytes, 9);
+	uint32_t poolSize = SnapshotField(bytes, 10), romSize = SnapshotField(bytes, 11);
+	uint64_t expected = LINK_STATE_HEADER + LinkRecordsSize(&counts) + (uint64_t)patchCount * LINK_STATE_PATCH +
+		(uint64_t)externalCount * LINK_STATE_EXTERNAL + poolSize + romSize;
+	if ((expected != fileState->Size) || (counts.Objects > INT32_MAX) || (romSize < ROM_FILL_SIZE) || ((poolSize > 0) && (bytes[expected - romSize - 1] != '\0'))) {
+		printf("ArgLink error: link state %s is damaged, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(65);
+	}
+	const uint8_t* patchRecords = bytes + LINK_STATE_HEADER + (size_t)LinkRecordsSize(&counts);
+	const uint8_t* externalRecords = patchRecords + (size_t)patchCount * LINK_STATE_PATCH;
+	const char* pool = (const char*)(externalRecords + (size_t)externalCount * LINK_STATE_EXTERNAL);
+	const uint8_t* romBytes = (const uint8_t*)pool + poolSize;
+
+	LinkSession* session = (LinkSession*)calloc(1, sizeof(LinkSession)); if (session == NULL) { puts("ArgLink error: cannot allocate for session of type LinkSession*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	session->Contents = fileState;
+	session->ObjectCount = (int32_t)counts.Objects;
+	session->Objects = (SobObject*)calloc((size_t)counts.Objects + 1, sizeof(SobObject)); if (session->Objects == NULL) { puts("ArgLink error: cannot allocate for session->Objects of type SobObject*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	session->Link = ReadLinkRecords(bytes + LINK_STATE_HEADER, &counts, pool, poolSize, session->Objects, "link state", path);
+	for (int32_t o = 0; o < session->ObjectCount; o++) {
+		SobObject* object = &session->Objects[o];
+		object->Patches = (Patch*)calloc(object->RelocationCount + 1, sizeof(Patch)); if (object->Patches == NULL) { puts("ArgLink error: cannot allocate for object->Patches of type Patch*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	}
+
+	// Each object gets back the patches of its relocations, and the index stays as sorted
+	session->Patches.Records = (PatchRecord*)calloc((size_t)patchCount + 1, sizeof(PatchRecord)); if (session->Patches.Records == NULL) { puts("ArgLink error: cannot allocate for session->Patches.Records of type PatchRecord*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	session->Patches.Count = patchCount;
+	session->Patches.Overlaps = SnapshotField(bytes, 12);
+	for (uint32_t i = 0; i < patchCount; i++) {
+		const uint8_t* record = patchRecords + (size_t)i * LINK_STATE_PATCH;
+		PatchRecord* patch = &session->Patches.Records[i];
+		patch->Start = SnapshotField(record, 0);
+		patch->Value = (int32_t)SnapshotField(record, 1);
+		patch->Width = (uint8_t)SnapshotField(record, 2);
+		patch->Object = (int32_t)SnapshotField(record, 3);
+		patch->Relocation = SnapshotField(record, 4);
+		if ((patch->Width < 1) || (patch->Width > 3) || ((uint32_t)patch->Object >= counts.Objects) || (patch->Relocation >= session->Objects[patch->Object].RelocationCount) ||
+			(patch->Start + patch->Width > romSize) || ((i > 0) && (ComparePatchStarts(&session->Patches.Records[i - 1], patch) >= 0))) {
+			printf("ArgLink error: link state %s is damaged, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(65);
+		}
+		Patch* target = &session->Objects[patch->Object].Patches[patch->Relocation];
+		target->Start = patch->Start;
+		target->Value = patch->Value;
+		target->Width = patch->Width;
+	}
+
+	session->Externals = ht_create(16);
+	for (uint32_t i = 0; i < externalCount; i++) {
+		const uint8_t* record = externalRecords + (size_t)i * LINK_STATE_EXTERNAL;
+		uint32_t at = SnapshotField(record, 0);
+		if ((at >= poolSize) || (ht_get(session->Externals, pool + at) != NULL)) { printf("ArgLink error: link state %s is damaged, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(65); }
+		ExternalFile* cached = (ExternalFile*)calloc(1, sizeof(ExternalFile)); if (cached == NULL) { puts("ArgLink error: cannot allocate for cached of type ExternalFile*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+		cached->FileSize = (int64_t)StateField64(record, 1);
+		cached->ModifiedTime = (int64_t)StateField64(record, 3);
+		ht_set(session->Externals, pool + at, cached);
+	}
+
+	session->Rom = RomImageCreate(romSize, 0);
+	memcpy(session->Rom->Bytes, romBytes, romSize);
+	return session;
+}
+
+LinkSession* LoadLinkState(const char* path)
+{
+	struct stat info;
+	if (stat(path, &info) != 0) {
+		return NULL;
+	}
+	return ReadLinkState(SobReaderOpen(path), path);
+}
+
+// Where ROM bytes must be rebuilt
+typedef struct RomRange {
+	int64_t Start;
+	int64_t End;           // Exclusive
+} RomRange;
+
+typedef struct RangeList {
+	RomRange* Ranges;
+	size_t Count;
+	size_t Capacity;
+} RangeList;
+
+void AddRange(RangeList* list, int64_t start, int64_t end)
+{
+	if (start >= end) {
+		return;
+	}
+	if (list->Count >= list->Capacity) {
+		list->Capacity = (list->Capacity > 0) ? list->Capacity * 2 : 64;
+		list->Ranges = (RomRange*)realloc(list->Ranges, list->Capacity * sizeof(RomRange)); if (list->Ranges == NULL) { puts("ArgLink error: cannot grow list of RomRange named list->Ranges, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	}
+	list->Ranges[list->Count].Start = start;
+	list->Ranges[list->Count].End = end;
+	list->Count++;
+}
+
+// Every byte the sections and patches of an object write
+void AddObjectRanges(RangeList* list, const SobObject* object)
+{
+	for (int32_t i = 0; i < object->SectionCount; i++) {
+		const SectionWrite* section = &object->Sections[i];
+		if ((section->Type == 0) || (section->Type == 1)) {
+			AddRange(list, section->Offset, (int64_t)section->Offset + (int64_t)section->Size);
+		}
+	}
+	for (size_t r = 0; (object->Patches != NULL) && (r < object->RelocationCount); r++) {
+		AddRange(list, object->Patches[r].Start, object->Patches[r].Start + object->Patches[r].Width);
+	}
+}
+
+int CompareRangeStarts(const void* a, const void* b)
+{
+	const RomRange* left = (const RomRange*)a;
+	const RomRange* right = (const RomRange*)b;
+	return (left->Start > right->Start) - (left->Start < right->Start);
+}
+
+// Sorts the ranges and merges those that overlap or touch
+void CoalesceRanges(RangeList* list)
+{
+	if (list->Count == 0) {
+		return;
+	}
+	qsort(list->Ranges, list->Count, sizeof(RomRange), CompareRangeStarts);
+	size_t kept = 0;
+	for (size_t i = 1; i < list->Count; i++) {
+		if (list->Ranges[i].Start <= list->Ranges[kept].End) {
+			if (list->Ranges[i].End > list->Ranges[kept].End) {
+				list->Ranges[kept].End = list->Ranges[i].End;
+			}
+		} else {
+			list->Ranges[++kept] = list->Ranges[i];
+		}
+	}
+	list->Count = kept + 1;
+}
+
+// As a full link sizes the ROM: the fill, then the end of the furthest section and patch
+int64_t RomSizeFor(const SobObject objects[], int32_t objectCount, const PatchIndex* patches)
+{
+	int64_t size = ROM_FILL_SIZE;
+	for (int32_t o = 0; o < objectCount; o++) {
+		for (int32_t i = 0; i < objects[o].SectionCount; i++) {
+			const SectionWrite* section = &objects[o].Sections[i];
+			if (((section->Type == 0) || (section->Type == 1)) && ((int64_t)section->Offset + (int64_t)section->Size > size)) {
+				size = (int64_t)section->Offset + (int64_t)section->Size;
+			}
+		}
+	}
+	// Sorted by start and at most 3 bytes wide, the furthest patch is one of the last ones
+	const PatchRecord* records = patches->Records;
+	for (size_t i = patches->Count; (i > 0) && (records[i - 1].Start + 3 > records[patches->Count - 1].Start); i--) {
+		if (records[i - 1].Start + records[i - 1].Width > size) {
+			size = records[i - 1].Start + records[i - 1].Width;
+		}
+	}
+	return size;
+}
+
+// reach[i] is the furthest end of blocks 0 to i, so the first block over an offset is found by bisection
+uint32_t* LayoutReach(const RomLayout* layout)
+{
+	uint32_t* reach = (uint32_t*)calloc((size_t)layout->Count + 1, sizeof(uint32_t)); if (reach == NULL) { puts("ArgLink error: cannot allocate for reach of type uint32_t*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	uint32_t furthest = 0;
+	for (uint32_t i = 0; i < layout->Count; i++) {
+		if (layout->Blocks[i].End > furthest) {
+			furthest = layout->Blocks[i].End;
+		}
+		reach[i] = furthest;
+	}
+	return reach;
+}
+
+int CompareBlockOrder(const void* a, const void* b)
+{
+	const LayoutBlock* left = (const LayoutBlock*)a;
+	const LayoutBlock* right = (const LayoutBlock*)b;
+	if (left->Object != right->Object) {
+		return (left->Object > right->Object) ? 1 : -1;
+	}
+	return (left->Section > right->Section) - (left->Section < right->Section);
+}
+
+// Rebuilds ROM bytes start to end - 1 as a full link leaves them: the fill, then the sections
+// over them in command-line order, then the patches over them in serial link order
+void RebuildRomRange(LinkSession* session, const RomLayout* layout, const uint32_t reach[], int64_t start, int64_t end)
+{
+	uint8_t* bytes = session->Rom->Bytes;
+	int64_t filled = (end < ROM_FILL_SIZE) ? end : ((start > ROM_FILL_SIZE) ? start : ROM_FILL_SIZE);
+	memset(bytes + start, 0xFF, (size_t)(filled - start));
+	memset(bytes + filled, 0, (size_t)(end - filled));
+
+	uint32_t low = 0, high = layout->Count;
+	while (low < high) {
+		uint32_t middle = low + (high - low) / 2;
+		if ((int64_t)reach[middle] > start) {
+			high = middle;
+		} else {
+			low = middle + 1;
+		}
+	}
+	LayoutBlock* covering = NULL;
+	size_t coveringCount = 0, coveringCapacity = 0;
+	for (uint32_t i = low; (i < layout->Count) && ((int64_t)layout->Blocks[i].Start < end); i++) {
+		if ((int64_t)layout->Blocks[i].End <= start) {
+			continue;
+		}
+		if (coveringCount >= coveringCapacity) {
+			coveringCapacity = (coveringCapacity > 0) ? coveringCapacity * 2 : 16;
+			covering = (LayoutBlock*)realloc(covering, coveringCapacity * sizeof(LayoutBlock)); if (covering == NULL) { puts("ArgLink error: cannot grow list of LayoutBlock named covering, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+		}
+		covering[coveringCount++] = layout->Blocks[i];
+	}
+	qsort(covering, coveringCount, sizeof(LayoutBlock), CompareBlockOrder);
+	for (size_t b = 0; b < coveringCount; b++) {
+		SobObject* object = &session->Objects[covering[b].Object];
+		const SectionWrite* section = &object->Sections[covering[b].Section];
+		if ((section->Type != 0) && (section->Type != 1)) {
+			continue;
+		}
+		int64_t from = (start > (int64_t)covering[b].Start) ? start : (int64_t)covering[b].Start;
+		int64_t to = (end < (int64_t)covering[b].End) ? end : (int64_t)covering[b].End;
+		size_t skip = (size_t)(from - (int64_t)covering[b].Start);
+		size_t copied;
+		if (section->Type == 0) {
+			MapObjectData(object);
+			copied = (section->DataSize > skip) ? section->DataSize - skip : 0;
+			if (copied > (size_t)(to - from)) {
+				copied = (size_t)(to - from);
+			}
+			memcpy(bytes + from, section->Data + skip, copied);
+		} else {
+			size_t wanted = (section->Size > skip) ? section->Size - skip : 0;
+			copied = CopyExternal(session->Externals, section->ExternalPath, skip, bytes + from, (wanted < (size_t)(to - from)) ? wanted : (size_t)(to - from));
+		}
+		memset(bytes + from + copied, 0, (size_t)(to - from) - copied);
+	}
+	free(covering);
+
+	// Patches are at most 3 bytes wide, so those over start begin at most 2 bytes before it
+	const PatchRecord* records = session->Patches.Records;
+	size_t first = 0, last = session->Patches.Count;
+	while (first < last) {
+		size_t middle = first + (last - first) / 2;
+		if (records[middle].Start < start - 2) {
+			first = middle + 1;
+		} else {
+			last = middle;
+		}
+	}
+	PatchRecord* group = NULL;
+	size_t groupCount = 0, groupCapacity = 0;
+	for (size_t i = first; (i < session->Patches.Count) && (records[i].Start < end); i++) {
+		if (records[i].Start + records[i].Width <= start) {
+			continue;
+		}
+		if (groupCount >= groupCapacity) {
+			groupCapacity = (groupCapacity > 0) ? groupCapacity * 2 : 16;
+			group = (PatchRecord*)realloc(group, groupCapacity * sizeof(PatchRecord)); if (group == NULL) { puts("ArgLink error: cannot grow list of PatchRecord named group, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+		}
+		group[groupCount++] = records[i];
+	}
+	qsort(group, groupCount, sizeof(PatchRecord), ComparePatchOrder);
+	for (size_t i = 0; i < groupCount; i++) {
+		for (int64_t w = 0; w < group[i].Width; w++) {
+			int64_t at = group[i].Start + w;
+			if ((at >= start) && (at < end)) {
+				bytes[at] = (uint8_t)(group[i].Value >> (8 * w));
+			}
+		}
+	}
+	free(group);
+}
+
+// A symbol value changed in place by a relink, put back if it gives up
+typedef struct SymbolMove {
+	uint32_t Symbol;
+	int32_t Value;
+} SymbolMove;
+
+// A patch of an unchanged object that gets another value
+typedef struct PatchUpdate {
+	int32_t Object;
+	uint32_t Relocation;
+	int32_t Value;
+} PatchUpdate;
+
+// What a relink prepares before it changes the session
+typedef struct Relink {
+	LinkSession* Session;
+	int32_t PathCount;
+	SobObject* Changed;        // Objects parsed again, in command-line order
+	int32_t* ChangedIndex;     // Index of each in the session
+	int32_t* ChangedAt;        // Index in Changed, plus 1, of each object, 0 when unchanged
+	int32_t ChangedCount;
+	ht* ChangedExternals;      // Path to the ExternalFile of the session
+	SymbolTable* Rebuilt;      // When publics were merged again, or NULL
+	uint32_t* Renumber;        // Old symbol ID to the ID in Rebuilt, or NO_SYMBOL
+	PublicDef** PublicCopies;  // Publics of unchanged objects, as merged into Rebuilt
+	SymbolMove* Moves;
+	size_t MoveCount;
+	bool* Moved;               // By ID in the table the relink ends with
+	ExpressionTable* Expressions; // While the changed objects are linked
+	PatchUpdate* Updates;
+	size_t UpdateCount;
+	size_t UpdateCapacity;
+} Relink;
+
+Relink* s_relinkInFlight; // For --watch to undo when an error ends the link
+
+// Sizes and times first: only files that differ are hashed, and only those whose contents
+// differ are relinked. Returns false, with the reason, when only a full link can do.
+bool FindChangedObjects(LinkSession* session, char* const paths[], int32_t pathCount, Relink* relink, const char** reason)
+{
+	int32_t oldCount = session->ObjectCount;
+	if (pathCount < oldCount) {
+		*reason = "objects were removed";
+		return false;
+	}
+	relink->Changed = (SobObject*)calloc((size_t)pathCount + 1, sizeof(SobObject)); if (relink->Changed == NULL) { puts("ArgLink error: cannot allocate for relink->Changed of type SobObject*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	relink->ChangedIndex = (int32_t*)calloc((size_t)pathCount + 1, sizeof(int32_t)); if (relink->ChangedIndex == NULL) { puts("ArgLink error: cannot allocate for relink->ChangedIndex of type int32_t*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	relink->ChangedAt = (int32_t*)calloc((size_t)pathCount + 1, sizeof(int32_t)); if (relink->ChangedAt == NULL) { puts("ArgLink error: cannot allocate for relink->ChangedAt of type int32_t*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	int32_t candidateCount = 0;
+	struct stat info;
+	for (int32_t o = 0; o < pathCount; o++) {
+		const SobObject* old = (o < oldCount) ? &session->Objects[o] : NULL;
+		if ((old != NULL) && (strcmp(old->Path, paths[o]) != 0)) {
+			*reason = "the object list changed";
+			return false;
+		}
+		if (stat(paths[o], &info) != 0) {
+			*reason = "an object file is missing";
+			return false;
+		}
+		if ((old != NULL) && ((uint64_t)info.st_size == old->FileSize) && (ModifiedNanoseconds(&info) == old->ModifiedTime)) {
+			continue;
+		}
+		relink->Changed[candidateCount].Path = (old != NULL) ? old->Path : paths[o];
+		relink->ChangedIndex[candidateCount++] = o;
+	}
+
+	RunOnWorkers(s_jobs, candidateCount, FingerprintObjectWork, relink->Changed);
+	for (int32_t c = 0; c < candidateCount; c++) {
+		SobObject candidate = relink->Changed[c];
+		int32_t o = relink->ChangedIndex[c];
+		SobObject* old = (o < oldCount) ? &session->Objects[o] : NULL;
+		if ((old != NULL) && (candidate.FileSize == old->FileSize) && (candidate.Fingerprint == old->Fingerprint)) {
+			// Only touched: the new time spares hashing it next time
+			old->ModifiedTime = candidate.ModifiedTime;
+			session->Unsaved = true;
+			SobReaderClose(candidate.Contents);
+			continue;
+		}
+		relink->ChangedIndex[relink->ChangedCount] = o;
+		relink->Changed[relink->ChangedCount++] = candidate;
+	}
+	memset(&relink->Changed[relink->ChangedCount], 0, (size_t)(candidateCount - relink->ChangedCount) * sizeof(SobObject));
+	for (int32_t c = 0; c < relink->ChangedCount; c++) {
+		relink->ChangedAt[relink->ChangedIndex[c]] = c + 1;
+	}
+
+	relink->ChangedExternals = ht_create(16);
+	hti kvp = ht_iterator(session->Externals); while (ht_next(&kvp)) {
+		ExternalFile* cached = (ExternalFile*)kvp.value;
+		if (stat(kvp.key, &info) != 0) {
+			*reason = "an external file is missing";
+			return false;
+		}
+		if (((int64_t)info.st_size != cached->FileSize) || (ModifiedNanoseconds(&info) != cached->ModifiedTime)) {
+			ht_set(relink->ChangedExternals, kvp.key, cached);
+		}
+	}
+	return true;
+}
+
+// Changed objects defining the same publics as before, in the same order and nowhere else,
+// only change symbol values. Otherwise publics are merged again in command-line order, so
+// IDs and values come out as in a full link; unchanged objects are merged from copies of
+// their publics, so the session stays as it was until the relink is committed.
+bool MergeChangedPublics(LinkSession* session, int32_t pathCount, Relink* relink, const char** reason)
+{
+	RunOnWorkers(s_jobs, relink->ChangedCount, ParseObjectWork, relink->Changed);
+	for (int32_t c = 0; c < relink->ChangedCount; c++) {
+		const SobObject* changed = &relink->Changed[c];
+		for (int32_t i = 0; i < changed->SectionCount; i++) {
+			const SectionWrite* section = &changed->Sections[i];
+			struct stat info;
+			if (((section->Type == 0) || (section->Type == 1)) && (section->Offset < 0)) {
+				*reason = "a section is out of range";
+				return false;
+			} else if ((section->Type == 1) && (stat(section->ExternalPath, &info) != 0)) {
+				*reason = "an external file is missing";
+				return false;
+			}
+		}
+	}
+
+	StatsPhase(PhasePublics);
+	SymbolTable* link = session->Link;
+	int32_t oldCount = session->ObjectCount;
+	bool sameNames = true;
+	size_t changedPublics = 0;
+	for (int32_t c = 0; sameNames && (c < relink->ChangedCount); c++) {
+		const SobObject* changed = &relink->Changed[c];
+		int32_t o = relink->ChangedIndex[c];
+		const SobObject* old = (o < oldCount) ? &session->Objects[o] : NULL;
+		sameNames = (changed->PublicCount == ((old != NULL) ? old->PublicCount : 0));
+		for (size_t p = 0; sameNames && (p < changed->PublicCount); p++) {
+			const PublicDef* before = &old->Publics[p];
+			const PublicDef* after = &changed->Publics[p];
+			sameNames = (link->Symbols[before->Symbol].Definitions == 1) && (before->Length == after->Length) &&
+				(memcmp(before->Name, after->Name, after->Length) == 0);
+		}
+		changedPublics += changed->PublicCount;
+	}
+	if (sameNames) {
+		relink->Moved = (bool*)calloc(link->Count + 1, sizeof(bool)); if (relink->Moved == NULL) { puts("ArgLink error: cannot allocate for relink->Moved of type bool*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+		relink->Moves = (SymbolMove*)calloc(changedPublics + 1, sizeof(SymbolMove)); if (relink->Moves == NULL) { puts("ArgLink error: cannot allocate for relink->Moves of type SymbolMove*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+		for (int32_t c = 0; c < relink->ChangedCount; c++) {
+			SobObject* changed = &relink->Changed[c];
+			for (size_t p = 0; p < changed->PublicCount; p++) {
+				uint32_t id = session->Objects[relink->ChangedIndex[c]].Publics[p].Symbol;
+				changed->Publics[p].Symbol = id;
+				if (link->Symbols[id].Value != changed->Publics[p].Value) {
+					relink->Moves[relink->MoveCount].Symbol = id;
+					relink->Moves[relink->MoveCount++].Value = link->Symbols[id].Value;
+					link->Symbols[id].Value = changed->Publics[p].Value;
+					relink->Moved[id] = true;
+				}
+			}
+		}
+		return true;
+	}
+
+	size_t publicCount = 0;
+	for (int32_t o = 0; o < pathCount; o++) {
+		publicCount += (relink->ChangedAt[o] > 0) ? relink->Changed[relink->ChangedAt[o] - 1].PublicCount : session->Objects[o].PublicCount;
+	}
+	relink->Rebuilt = SymbolTableCreate(publicCount * 100 / s_stringHashLoad + 16, publicCount);
+	relink->PublicCopies = (PublicDef**)calloc((size_t)pathCount + 1, sizeof(PublicDef*)); if (relink->PublicCopies == NULL) { puts("ArgLink error: cannot allocate for relink->PublicCopies of type PublicDef**, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	for (int32_t o = 0; o < pathCount; o++) {
+		if (relink->ChangedAt[o] > 0) {
+			MergePublics(relink->Rebuilt, &relink->Changed[relink->ChangedAt[o] - 1], false);
+			continue;
+		}
+		SobObject view = session->Objects[o];
+		view.Publics = (PublicDef*)calloc(view.PublicCount + 1, sizeof(PublicDef)); if (view.Publics == NULL) { puts("ArgLink error: cannot allocate for view.Publics of type PublicDef*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+		memcpy(view.Publics, session->Objects[o].Publics, view.PublicCount * sizeof(PublicDef));
+		relink->PublicCopies[o] = view.Publics;
+		MergePublics(relink->Rebuilt, &view, false);
+	}
+
+	relink->Renumber = (uint32_t*)calloc(link->Count + 1, sizeof(uint32_t)); if (relink->Renumber == NULL) { puts("ArgLink error: cannot allocate for relink->Renumber of type uint32_t*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	relink->Moved = (bool*)calloc(relink->Rebuilt->Count + 1, sizeof(bool)); if (relink->Moved == NULL) { puts("ArgLink error: cannot allocate for relink->Moved of type bool*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	for (size_t id = 0; id < link->Count; id++) {
+		const LinkData* symbol = &link->Symbols[id];
+		void* ref = ht_get_hashed(relink->Rebuilt->Index, symbol->Name, strlen(symbol->Name), symbol->Hash);
+		relink->Renumber[id] = (ref != NULL) ? SymbolId(ref) : NO_SYMBOL;
+		if ((ref != NULL) && (relink->Rebuilt->Symbols[SymbolId(ref)].Value != symbol->Value)) {
+			relink->Moved[SymbolId(ref)] = true;
+		}
+	}
+	// A symbol no longer defined must no longer be used; the full link reports where
+	for (int32_t o = 0; o < oldCount; o++) {
+		for (size_t r = 0; (relink->ChangedAt[o] == 0) && (r < session->Objects[o].RelocationCount); r++) {
+			const Relocation* reloc = &session->Objects[o].Relocations[r];
+			if ((relink->Renumber[reloc->Symbol] == NO_SYMBOL) || (relink->Renumber[reloc->TermSymbol] == NO_SYMBOL)) {
+				*reason = "a symbol in use is no longer defined";
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// Changed objects are resolved and evaluated in full. Elsewhere, only relocations using a
+// symbol that moved are evaluated again, and kept when their value changed.
+bool LinkChangedObjects(LinkSession* session, Relink* relink, const char** reason)
+{
+	StatsPhase(PhaseResolve);
+	const SymbolTable* target = (relink->Rebuilt != NULL) ? relink->Rebuilt : session->Link;
+	for (int32_t c = 0; c < relink->ChangedCount; c++) {
+		for (size_t r = 0; r < relink->Changed[c].RelocationCount; r++) {
+			Relocation* reloc = &relink->Changed[c].Relocations[r];
+			const char* names[2] = { reloc->Name, (reloc->Secondary != NULL) ? reloc->Secondary : reloc->Name };
+			uint32_t* ids[2] = { &reloc->Symbol, &reloc->TermSymbol };
+			for (int k = 0; k < 2; k++) {
+				void* ref = ht_get(target->Index, names[k]);
+				if (ref == NULL) {
+					*reason = "a symbol is unresolved";
+					return false;
+				}
+				*ids[k] = SymbolId(ref);
+			}
+		}
+	}
+	relink->Expressions = ExpressionTableCreate(CountRelocations(relink->Changed, relink->ChangedCount));
+	CompileRelocations(relink->Expressions, target->Symbols, relink->Changed, relink->ChangedCount);
+
+	StatsPhase(PhaseImage);
+	LinkWork work;
+	work.Symbols = target->Symbols;
+	work.Expressions = relink->Expressions;
+	work.Objects = relink->Changed;
+	RunOnWorkers(s_jobs, relink->ChangedCount, PerformLinkWork, &work);
+	ExpressionTableDestroy(relink->Expressions);
+	relink->Expressions = NULL;
+	for (int32_t c = 0; c < relink->ChangedCount; c++) {
+		for (size_t r = 0; (relink->Changed[c].Patches != NULL) && (r < relink->Changed[c].RelocationCount); r++) {
+			if ((relink->Changed[c].Patches[r].Width > 0) && (relink->Changed[c].Patches[r].Start < 0)) {
+				*reason = "a relocation is out of range";
+				return false;
+			}
+		}
+	}
+
+	relink->Expressions = ExpressionTableCreate(0);
+	for (int32_t o = 0; o < session->ObjectCount; o++) {
+		const SobObject* object = &session->Objects[o];
+		for (size_t r = 0; (relink->ChangedAt[o] == 0) && (r < object->RelocationCount); r++) {
+			const Relocation* reloc = &object->Relocations[r];
+			uint32_t symbol = (relink->Renumber != NULL) ? relink->Renumber[reloc->Symbol] : reloc->Symbol;
+			uint32_t termSymbol = (relink->Renumber != NULL) ? relink->Renumber[reloc->TermSymbol] : reloc->TermSymbol;
+			if ((!relink->Moved[symbol] && !relink->Moved[termSymbol]) || (object->Patches[r].Width == 0)) {
+				continue;
+			}
+			uint32_t id = InternExpression(relink->Expressions, &object->Terms[reloc->FirstTerm], reloc->TermCount);
+			int32_t value = RunExpression(relink->Expressions, id, target->Symbols[symbol].Value, target->Symbols[termSymbol].Value);
+			if (value == object->Patches[r].Value) {
+				continue;
+			}
+			if (relink->UpdateCount >= relink->UpdateCapacity) {
+				relink->UpdateCapacity = (relink->UpdateCapacity > 0) ? relink->UpdateCapacity * 2 : 64;
+				relink->Updates = (PatchUpdate*)realloc(relink->Updates, relink->UpdateCapacity * sizeof(PatchUpdate)); if (relink->Updates == NULL) { puts("ArgLink error: cannot grow list of PatchUpdate named relink->Updates, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+			}
+			PatchUpdate* update = &relink->Updates[relink->UpdateCount++];
+			update->Object = o;
+			update->Relocation = (uint32_t)r;
+			update->Value = value;
+		}
+	}
+	ExpressionTableDestroy(relink->Expressions);
+	relink->Expressions = NULL;
+	return true;
+}
+
+// Nothing can fail from here on but reading the files that were just checked
+void CommitRelink(LinkSession* session, int32_t pathCount, Relink* relink)
+{
+	int32_t oldCount = session->ObjectCount;
+	if (pathCount > oldCount) {
+		session->Objects = (SobObject*)realloc(session->Objects, ((size_t)pathCount + 1) * sizeof(SobObject)); if (session->Objects == NULL) { puts("ArgLink error: cannot grow list of SobObject named session->Objects, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+		memset(&session->Objects[oldCount], 0, ((size_t)(pathCount - oldCount) + 1) * sizeof(SobObject));
+	}
+	SobObject* objects = session->Objects;
+
+	// What changed objects wrote before and write now is rebuilt, with the patches that changed
+	RangeList dirty;
+	memset(&dirty, 0, sizeof(dirty));
+	for (int32_t c = 0; c < relink->ChangedCount; c++) {
+		int32_t o = relink->ChangedIndex[c];
+		if (o < oldCount) {
+			AddObjectRanges(&dirty, &objects[o]);
+			ReleaseObjectData(&objects[o]);
+			FreeParsedObject(&objects[o]);
+		}
+		AddObjectRanges(&dirty, &relink->Changed[c]);
+		objects[o] = relink->Changed[c];
+	}
+	session->ObjectCount = pathCount;
+	for (size_t u = 0; u < relink->UpdateCount; u++) {
+		Patch* patch = &objects[relink->Updates[u].Object].Patches[relink->Updates[u].Relocation];
+		AddRange(&dirty, patch->Start, patch->Start + patch->Width);
+		patch->Value = relink->Updates[u].Value;
+	}
+
+	if (relink->Rebuilt != NULL) {
+		for (int32_t o = 0; o < oldCount; o++) {
+			if (relink->ChangedAt[o] > 0) {
+				continue;
+			}
+			free(objects[o].Publics);
+			objects[o].Publics = relink->PublicCopies[o];
+			objects[o].PublicCapacity = objects[o].PublicCount;
+			relink->PublicCopies[o] = NULL;
+			for (size_t r = 0; r < objects[o].RelocationCount; r++) {
+				objects[o].Relocations[r].Symbol = relink->Renumber[objects[o].Relocations[r].Symbol];
+				objects[o].Relocations[r].TermSymbol = relink->Renumber[objects[o].Relocations[r].TermSymbol];
+			}
+		}
+		SymbolTable* old = session->Link;
+		session->Link = relink->Rebuilt;
+		relink->Rebuilt = NULL;
+		for (int32_t o = 0; o < pathCount; o++) {
+			InternObjectNames(&objects[o], session->Link);
+		}
+		SymbolTableDestroy(old);
+	}
+
+	// Patches of changed objects replace their old ones, merged in order
+	PatchIndex* index = &session->Patches;
+	size_t addedCount = 0;
+	for (int32_t c = 0; c < relink->ChangedCount; c++) {
+		for (size_t r = 0; (relink->Changed[c].Patches != NULL) && (r < relink->Changed[c].RelocationCount); r++) {
+			addedCount += (relink->Changed[c].Patches[r].Width > 0) ? 1 : 0;
+		}
+	}
+	PatchRecord* added = (PatchRecord*)calloc(addedCount + 1, sizeof(PatchRecord)); if (added == NULL) { puts("ArgLink error: cannot allocate for added of type PatchRecord*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	addedCount = 0;
+	for (int32_t c = 0; c < relink->ChangedCount; c++) {
+		for (size_t r = 0; (relink->Changed[c].Patches != NULL) && (r < relink->Changed[c].RelocationCount); r++) {
+			const Patch* patch = &relink->Changed[c].Patches[r];
+			if (patch->Width > 0) {
+				PatchRecord* record = &added[addedCount++];
+				record->Start = patch->Start;
+				record->Value = patch->Value;
+				record->Width = patch->Width;
+				record->Object = relink->ChangedIndex[c];
+				record->Relocation = (uint32_t)r;
+			}
+		}
+	}
+	qsort(added, addedCount, sizeof(PatchRecord), ComparePatchStarts);
+	PatchRecord* merged = (PatchRecord*)calloc(index->Count + addedCount + 1, sizeof(PatchRecord)); if (merged == NULL) { puts("ArgLink error: cannot allocate for merged of type PatchRecord*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	size_t kept = 0, next = 0, mergedCount = 0;
+	while ((kept < index->Count) || (next < addedCount)) {
+		if ((kept < index->Count) && (relink->ChangedAt[index->Records[kept].Object] > 0)) {
+			kept++;
+		} else if ((next >= addedCount) || ((kept < index->Count) && (ComparePatchStarts(&index->Records[kept], &added[next]) < 0))) {
+			merged[mergedCount++] = index->Records[kept++];
+		} else {
+			merged[mergedCount++] = added[next++];
+		}
+	}
+	free(added);
+	free(index->Records);
+	index->Records = merged;
+	index->Count = mergedCount;
+	for (size_t u = 0; u < relink->UpdateCount; u++) {
+		PatchRecord key;
+		memset(&key, 0, sizeof(key));
+		key.Start = objects[relink->Updates[u].Object].Patches[relink->Updates[u].Relocation].Start;
+		key.Object = relink->Updates[u].Object;
+		key.Relocation = relink->Updates[u].Relocation;
+		PatchRecord* found = (PatchRecord*)bsearch(&key, merged, mergedCount, sizeof(PatchRecord), ComparePatchStarts);
+		if (found != NULL) {
+			found->Value = relink->Updates[u].Value;
+		}
+	}
+	index->Overlaps = 0;
+	for (size_t first = 0; first < mergedCount; ) {
+		size_t last = PatchGroupEnd(merged, mergedCount, first);
+		index->Overlaps += (last - first > 1) ? 1 : 0;
+		first = last;
+	}
+
+	RomImage* rom = session->Rom;
+	int64_t size = RomSizeFor(objects, pathCount, index);
+	if (size > (int64_t)rom->Size) {
+		RomImageAt(rom, size - 1, 1);
+	} else {
+		rom->Size = (size_t)size;
+	}
+	if (ht_length(relink->ChangedExternals) > 0) {
+		for (int32_t o = 0; o < pathCount; o++) {
+			for (int32_t i = 0; i < objects[o].SectionCount; i++) {
+				const SectionWrite* section = &objects[o].Sections[i];
+				if ((section->Type == 1) && (ht_get(relink->ChangedExternals, section->ExternalPath) != NULL)) {
+					AddRange(&dirty, section->Offset, (int64_t)section->Offset + (int64_t)section->Size);
+				}
+			}
+		}
+	}
+	CoalesceRanges(&dirty);
+	RomLayout* layout = RomLayoutFor(objects, pathCount);
+	uint32_t* reach = LayoutReach(layout);
+	for (size_t i = 0; i < dirty.Count; i++) {
+		int64_t end = (dirty.Ranges[i].End < (int64_t)rom->Size) ? dirty.Ranges[i].End : (int64_t)rom->Size;
+		if (dirty.Ranges[i].Start < end) {
+			RebuildRomRange(session, layout, reach, dirty.Ranges[i].Start, end);
+		}
+	}
+	free(reach);
+	RomLayoutDestroy(layout);
+	free(dirty.Ranges);
+
+	for (int32_t o = 0; o < pathCount; o++) {
+		if (objects[o].Contents != NULL) {
+			InternObjectNames(&objects[o], session->Link);
+			ReleaseObjectData(&objects[o]);
+		}
+	}
+	// Only the external files still copied are kept, with their sizes and times
+	ht* externals = ht_create(16);
+	for (int32_t o = 0; o < pathCount; o++) {
+		for (int32_t i = 0; i < objects[o].SectionCount; i++) {
+			const char* path = objects[o].Sections[i].ExternalPath;
+			if ((objects[o].Sections[i].Type == 1) && (ht_get(externals, path) == NULL)) {
+				ExternalFile* cached = (ExternalFile*)ht_remove(session->Externals, path);
+				if (cached != NULL) {
+					ht_set(externals, path, cached);
+				}
+			}
+		}
+	}
+	DestroyExternalFiles(session->Externals);
+	ReleaseExternalFiles(externals);
+	session->Externals = externals;
+}
+
+// Frees what a relink prepared; when it gave up, what it already changed is put back
+void RelinkDiscard(Relink* relink, LinkSession* session, bool undo)
+{
+	if (undo) {
+		for (size_t m = 0; m < relink->MoveCount; m++) {
+			session->Link->Symbols[relink->Moves[m].Symbol].Value = relink->Moves[m].Value;
+		}
+		for (int32_t c = 0; c < relink->ChangedCount; c++) {
+			ReleaseObjectData(&relink->Changed[c]);
+			FreeParsedObject(&relink->Changed[c]);
+		}
+	}
+	if (relink->Rebuilt != NULL) {
+		SymbolTableDestroy(relink->Rebuilt);
+	}
+	if (relink->Expressions != NULL) {
+		ExpressionTableDestroy(relink->Expressions);
+	}
+	for (int32_t o = 0; (relink->PublicCopies != NULL) && (o < relink->PathCount); o++) {
+		free(relink->PublicCopies[o]);
+	}
+	if (relink->ChangedExternals != NULL) {
+		ht_destroy(relink->ChangedExternals);
+	}
+	free(relink->Changed); free(relink->ChangedIndex); free(relink->ChangedAt);
+	free(relink->Renumber); free(relink->PublicCopies); free(relink->Moves); free(relink->Moved); free(relink->Updates);
+}
+
+// Relinks the session for the objects at paths, which must start with those of the session,
+// in the same order. Returns how many objects changed, or -1 with the reason when only a
+// full link can do; the session is then as it was.
+int32_t RelinkSession(LinkSession* session, char* const paths[], int32_t pathCount, const char** reason)
+{
+	// On the heap, so --watch can still discard it once an error left this function
+	Relink* relink = (Relink*)calloc(1, sizeof(Relink)); if (relink == NULL) { puts("ArgLink error: cannot allocate for relink of type Relink*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	relink->Session = session;
+	relink->PathCount = pathCount;
+	s_relinkInFlight = relink;
+	if (!FindChangedObjects(session, paths, pathCount, relink, reason) ||
+		!MergeChangedPublics(session, pathCount, relink, reason) ||
+		!LinkChangedObjects(session, relink, reason)) {
+		RelinkDiscard(relink, session, true);
+		free(relink);
+		s_relinkInFlight = NULL;
+		return -1;
+	}
+	int32_t changedCount = relink->ChangedCount;
+	if ((changedCount > 0) || (ht_length(relink->ChangedExternals) > 0)) {
+		session->Changing = true;
+		CommitRelink(session, pathCount, relink);
+		session->Changing = false;
+		session->Unsaved = true;
+	}
+	RelinkDiscard(relink, session, false);
+	free(relink);
+	s_relinkInFlight = NULL;
+	return changedCount;
+}
+
+// --verify-full: links every object again from scratch, quietly, and compares the ROMs
+void VerifyFullLink(const SobObject linked[], int32_t objectCount, bool hashSizeGiven, const RomImage* rom)
+{
+	bool verbose = s_verbose;
+	s_verbose = false;
+	SobObject* objects = (SobObject*)calloc((size_t)objectCount + 1, sizeof(SobObject)); if (objects == NULL) { puts("ArgLink error: cannot allocate for objects of type SobObject*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	for (int32_t o = 0; o < objectCount; o++) {
+		objects[o].Path = linked[o].Path;
+	}
+	StatsPhase(PhaseParse);
+	RunOnWorkers(s_jobs, objectCount, ParseObjectWork, objects);
+
+	RomImage* full = RomImageCreate(ROM_FILL_SIZE, 0xFF);
+	SymbolTable* link = SymbolTableFor(objects, objectCount, hashSizeGiven);
+	ht* externals = ht_create(16);
+	MergeObjects(link, objects, objectCount, full, externals, false);
+	StatsPhase(PhaseResolve);
+	ResolveRelocations(link, objects, objectCount);
+	ExpressionTable* expressions = ExpressionTableCreate(CountRelocations(objects, objectCount));
+	CompileRelocations(expressions, link->Symbols, objects, objectCount);
+	StatsPhase(PhaseImage);
+	PatchIndex patches = LinkObjects(link->Symbols, expressions, objects, objectCount, full, OverlapsQuiet);
+
+	size_t common = (full->Size < rom->Size) ? full->Size : rom->Size;
+	size_t difference = 0;
+	while ((difference < common) && (full->Bytes[difference] == rom->Bytes[difference])) {
+		difference++;
+	}
+	if ((difference < common) || (full->Size != rom->Size)) {
+		printf("ArgLink error: incremental link differs from full link at ROM offset %" PRIX64 ", source code line " STRINGIZE(__LINE__) "\n", (uint64_t)difference);
+		LinkExit(70);
+	}
+
+	for (int32_t o = 0; o < objectCount; o++) {
+		ReleaseObjectData(&objects[o]);
+		FreeParsedObject(&objects[o]);
+	}
+	free(objects);
+	free(patches.Records);
+	DestroyExternalFiles(externals);
+	ExpressionTableDestroy(expressions);
+	SymbolTableDestroy(link);
+	RomImageDestroy(full);
+	s_verbose = verbose;
+}
+
+#pragma mark - Link driver
+// What main gathered from the command line for a link, which --watch repeats
+typedef struct LinkOptions {
+	char* RomFile;
+	char* PubsPath;
+	char* StatePath;
+	char* SnapshotIn;
+	char* SnapshotOut;
+	char* SymbolDbPath;
+	char* FreeMapPath;
+	char* StatsPath;
+	bool ShowPublics;
+	bool WarnDupes;
+	bool HashSizeGiven;
+	bool VerifyFull;
+	bool WriteMap;
+	bool ShowBlocks;
+	uint16_t LayoutKiB;
+	char** Paths;          // Of the object files, none with a snapshot
+	int32_t PathCount;
+} LinkOptions;
+
+// What the link under way owns, for --watch to free when an error ends the link
+typedef struct LinkInFlight {
+	FILE* Output;
+	SobObject* Objects;            // Parsed by a full link, with the symbol table, ROM and
+	int32_t ObjectCount;           // external files below, until a session takes them over
+	SymbolTable* Link;
+	RomImage* Rom;
+	ht* Externals;
+	PatchRecord* Patches;
+	RomLayout* Layout;
+	ExpressionTable* Expressions;
+	LinkSession* Session;          // Loaded or made by the link, until it becomes resident
+} LinkInFlight;
+
+bool s_watching; // = false;
+LinkSession* s_residentSession; // Of the last good link under --watch
+LinkInFlight s_inFlight;
+
+int32_t LinkRom(const LinkOptions* options)
+{
+	int32_t idx;
+	// The image is written with a single call, so the output file needs no stdio buffer
+	FILE* fileOut = fopen(options->RomFile, "wb"); if (fileOut == NULL) { puts("ArgLink error: cannot open romFile in Write mode, source code line " STRINGIZE(__LINE__)); LinkExit(73); }; setvbuf(fileOut, NULL, _IONBF, 0);
+	s_inFlight.Output = fileOut;
+	if (options->StatsPath != NULL) {
+		StatsBegin();
+	}
+	// Fill Output image to 1 MiB
+	puts("Constructing ROM Image.");
+	RomImage* rom = NULL;
+
+	// Steps 1 & 2: Input all data and list all links
+	StatsPhase(PhaseParse);
+	puts("Processing Externals.");
+	SobObject* objects;
+	int32_t n = 0;
+	SymbolTable* link;
+	LinkSession* session = NULL;
+	LinkSnapshot* snapshot = NULL;
+	ht* externals = NULL;
+	bool incremental = (options->StatePath != NULL) || s_watching;
+	if (options->SnapshotIn != NULL) {
+		// Objects and symbols come ready from the snapshot, only sections remain to be copied
+		snapshot = LoadLinkSnapshot(options->SnapshotIn);
+		objects = snapshot->Objects;
+		n = snapshot->ObjectCount;
+		link = snapshot->Link;
+		rom = RomImageCreate(ROM_FILL_SIZE, 0xFF);
+		externals = ht_create(16);
+		MergeObjects(NULL, objects, n, rom, externals, options->WarnDupes);
+	} else {
+		char* const* paths = options->Paths;
+		n = options->PathCount;
+
+		// An incremental link starts from the session of the previous link
+		const char* reason = "no link state";
+		if (incremental && (options->WarnDupes || s_verbose || (options->SnapshotOut != NULL))) {
+			reason = "-C, -V and --save-snapshot need a full link";
+		} else if (s_residentSession != NULL) {
+			session = s_residentSession;
+		} else if (options->StatePath != NULL) {
+			session = LoadLinkState(options->StatePath);
+			s_inFlight.Session = session;
+		}
+		int32_t changed = (session != NULL) ? RelinkSession(session, paths, n, &reason) : -1;
+		if (changed >= 0) {
+			printf("Reusing %" PRId32 " unchanged object(s) of %" PRId32 ".\n", n - changed, n);
+			objects = session->Objects;
+			link = session->Link;
+			rom = session->Rom;
+		} else {
+			// A resident session stays until a full link replaces it
+			if ((session != NULL) && (session != s_residentSession)) {
+				LinkSessionDestroy(session);
+			}
+			session = NULL;
+			s_inFlight.Session = NULL;
+			if (incremental) {
+				printf("Linking all %" PRId32 " object(s): %s.\n", n, reason);
+			}
+			objects = (SobObject*)calloc((size_t)n + 1, sizeof(SobObject)); if (objects == NULL) { puts("ArgLink error: cannot allocate for objects of type SobObject*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+			for (idx = 0; idx < n; idx++) {
+				objects[idx].Path = paths[idx];
+			}
+			s_inFlight.Objects = objects;
+			s_inFlight.ObjectCount = n;
+
+			// Objects are parsed independently, then merged in command-line order,
+			// so the output does not depend on -J
+			RunOnWorkers(s_jobs, n, ParseObjectWork, objects);
+
+			rom = RomImageCreate(ROM_FILL_SIZE, 0xFF);
+			link = SymbolTableFor(objects, n, options->HashSizeGiven);
+			externals = ht_create(16);
+			s_inFlight.Rom = rom;
+			s_inFlight.Link = link;
+			s_inFlight.Externals = externals;
+			MergeObjects(link, objects, n, rom, externals, options->WarnDupes);
+		}
+	}
+
+	StatsPhase(PhaseResolve);
+	if (s_stats != NULL) {
+		s_stats->SymbolsInserted = link->Count;
+	}
+	// Sections overwriting each other are not an error, as with the original ArgLink
+	RomLayout* layout = RomLayoutFor(objects, n);
+	s_inFlight.Layout = layout;
+	ReportLayoutOverlaps(layout);
+
+	if (options->ShowPublics) {
+		puts("Public Symbols Defined:");
+		const LinkData** sorted = SortedSymbols(link, false);
+		for (size_t i = 0; i < link->Count; i++) {
+			printf("FILE: %-17s -- SYMBOL: %-30s -- VALUE: %6" PRIX32 "\n", sorted[i]->Origin, sorted[i]->Name, sorted[i]->Value);
+		}
+		free(sorted);
+	}
+	if (options->SymbolDbPath != NULL) {
+		SaveSymbolDatabase(options->SymbolDbPath, link);
+	}
+
+	if ((snapshot == NULL) && (session == NULL)) {
+		ResolveRelocations(link, objects, n);
+	}
+	if (options->SnapshotOut != NULL) {
+		SaveLinkSnapshot(options->SnapshotOut, link, objects, n);
+	}
+	ExpressionTable* expressions = (session == NULL) ? ExpressionTableCreate(CountRelocations(objects, n)) : NULL;
+	s_inFlight.Expressions = expressions;
+	if (expressions != NULL) {
+		CompileRelocations(expressions, link->Symbols, objects, n);
+	}
+
+	// Step 3: Link everything
+	StatsPhase(PhaseImage);
+	if (s_stats != NULL) {
+		ht_get_stats(link->Index, &s_stats->Table);
+	}
+	puts("Writing Image.");
+	LuigiOut("----LINK");
+	PatchIndex patches;
+	memset(&patches, 0, sizeof(patches));
+	if (session == NULL) {
+		patches = LinkObjects(link->Symbols, expressions, objects, n, rom, options->WarnDupes ? OverlapsListed : OverlapsCounted);
+		s_inFlight.Patches = patches.Records;
+	} else {
+		ReportOverlapCount(session->Patches.Overlaps);
+	}
+	for (idx = 0; (s_stats != NULL) && (idx < n); idx++) {
+		s_stats->RelocationsApplied += objects[idx].Linkable ? objects[idx].RelocationCount : 0;
+	}
+	if (options->VerifyFull) {
+		VerifyFullLink(objects, n, options->HashSizeGiven, rom);
+	}
+	StatsPhase(PhaseExport);
+	if (options->ShowBlocks) {
+		OutputRomBlocks(layout);
+	}
+	if (options->LayoutKiB > 0) {
+		OutputRomLayout(layout, options->LayoutKiB);
+	}
+	if (options->FreeMapPath != NULL) {
+		SaveFreeSpaceBitmap(options->FreeMapPath, layout, rom->Size);
+	}
+	RomLayoutDestroy(layout);
+	s_inFlight.Layout = NULL;
+	if (options->WriteMap) {
+		char* mapPath = MapPathFor(options->RomFile);
+		WriteMapFile(mapPath, options->RomFile, link, objects, n);
+		free(mapPath);
+	}
+	if (incremental && (session == NULL)) {
+		session = LinkSessionCreate(objects, n, link, rom, patches, externals);
+		s_inFlight.Objects = NULL;
+		s_inFlight.Link = NULL;
+		s_inFlight.Rom = NULL;
+		s_inFlight.Externals = NULL;
+		s_inFlight.Patches = NULL;
+		s_inFlight.Session = session;
+	}
+	if ((options->StatePath != NULL) && session->Unsaved) {
+		SaveLinkState(options->StatePath, session);
+		session->Unsaved = false;
+	}
+	if (session == NULL) {
+		for (idx = 0; idx < n; idx++) {
+			ReleaseObjectData(&objects[idx]);
+			FreeParsedObject(&objects[idx]);
+		}
+		free(patches.Records);
+		DestroyExternalFiles(externals);
+		s_inFlight.ObjectCount = 0;
+		s_inFlight.Patches = NULL;
+		s_inFlight.Externals = NULL;
+	}
+	if (expressions != NULL) {
+		ExpressionTableDestroy(expressions);
+		s_inFlight.Expressions = NULL;
+	}
+	if (snapshot != NULL) {
+		SobReaderClose(snapshot->Contents);
+		free(snapshot);
+	}
+
+	int64_t finalSize = (int64_t)rom->Size;
+	finalSize = (finalSize / 1024) + ((finalSize % 1024) > 0 ? 1 : 0);
+	printf("| Publics: %" PRIuPTR "\tFiles: %" PRId32 "\tROM Size: %" PRId64 "KiB |\n", link->Count, n, finalSize);
+
+	RomImageFlush(rom, fileOut);
+	fclose(fileOut);
+	s_inFlight.Output = NULL;
+
+	if (!((options->PubsPath == NULL) || (strlen(options->PubsPath) < 1))) {
+		FILE* filePubs = fopen(options->PubsPath, "wb"); if (filePubs == NULL) { puts("ArgLink error: cannot open pubsPath in Write mode, source code line " STRINGIZE(__LINE__)); LinkExit(73); }; size_t filePubsZone = (size_t)(s_ioBuffersKiB * 1024); char* filePubsBuffer = (filePubsZone > 0) ? (char*)calloc(filePubsZone, sizeof(char)) : NULL; setvbuf(filePubs, filePubsBuffer, filePubsBuffer ? _IOFBF : _IONBF, filePubsZone);
+		const LinkData** sorted = SortedSymbols(link, false);
+		for (size_t i = 0; i < link->Count; i++) {
+			fprintf(filePubs, "%s\n", sorted[i]->Name);
+		}
+		free(sorted);
+		if (s_stats != NULL) {
+			StatsWrote((size_t)ftell(filePubs), 1);
+		}
+		fclose(filePubs); free(filePubsBuffer);
+	}
+
+	// The session owns the objects, symbol table and ROM it took over; under --watch, it
+	// stays resident for the next link
+	if (s_watching) {
+		if ((s_residentSession != NULL) && (s_residentSession != session)) {
+			LinkSessionDestroy(s_residentSession);
+		}
+		s_residentSession = session;
+	} else if (session != NULL) {
+		LinkSessionDestroy(session);
+	} else {
+		RomImageDestroy(rom);
+		SymbolTableDestroy(link);
+	}
+	memset(&s_inFlight, 0, sizeof(s_inFlight));
+	if (options->StatsPath != NULL) {
+		SaveLinkStats(options->StatsPath);
+	}
+	return (int32_t)Success;
+}
+
+#pragma mark - Watch mode
+// --watch: the session of the last good link (parsed objects, symbol table, ROM image and
+// patches) stays resident, and each change is relinked into it. A link error jumps back to
+// the watcher instead of ending the process, and what the link owned is freed. Files are
+// watched with inotify on Linux (through their directories, as editors often replace
+// files), elsewhere by polling.
+#ifdef ARGLINK_HAVE_WATCH
+#define WATCH_SETTLE_MS 20
+#define WATCH_POLL_MS 250
+
+ht* s_failedExternals; // External files a failed link tried to read, watched until a link succeeds
+
+typedef struct WatchedFile {
+	int64_t FileSize;        // -1 while the file is missing
+	int64_t ModifiedTime;
+	int64_t ChangedTime;
+	char* Path;
+} WatchedFile;
+
+typedef struct WatchedDirectory {
+	int Descriptor;
+	char* Path;              // Empty for the root directory
+} WatchedDirectory;
+
+typedef struct WatchList {
+	int Notify;              // inotify descriptor, -1 when polling
+	ht* Index;               // Directory, slash and file name, as inotify reports them
+	WatchedFile* Files;
+	size_t FileCount;
+	size_t FileCapacity;
+	WatchedDirectory* Directories;
+	size_t DirectoryCount;
+	size_t DirectoryCapacity;
+} WatchList;
+
+void StatWatchedFile(WatchedFile* file)
+{
+	struct stat info;
+	if (stat(file->Path, &info) == 0) {
+		file->FileSize = (int64_t)info.st_size;
+		file->ModifiedTime = (int64_t)info.st_mtime;
+		file->ChangedTime = (int64_t)info.st_ctime;
+	} else {
+		file->FileSize = -1;
+		file->ModifiedTime = 0;
+		file->ChangedTime = 0;
+	}
+}
+
+void WatchFile(WatchList* list, const char* path)
+{
+	const char* slash = strrchr(path, '/');
+	size_t directoryLength = (slash != NULL) ? (size_t)(slash - path) : 1;
+	size_t nameLength = strlen((slash != NULL) ? slash + 1 : path);
+	char* key = (char*)calloc(directoryLength + nameLength + 2, sizeof(char)); if (key == NULL) { puts("ArgLink error: cannot allocate for key of type char*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	memcpy(key, (slash != NULL) ? path : ".", directoryLength);
+	key[directoryLength] = '/';
+	memcpy(key + directoryLength + 1, (slash != NULL) ? slash + 1 : path, nameLength);
+	if (ht_get(list->Index, key) != NULL) {
+		free(key);
+		return;
+	}
+	ht_set(list->Index, key, list);
+
+	if (list->FileCount >= list->FileCapacity) {
+		list->FileCapacity = (list->FileCapacity > 0) ? list->FileCapacity * 2 : 64;
+		list->Files = (WatchedFile*)realloc(list->Files, list->FileCapacity * sizeof(WatchedFile)); if (list->Files == NULL) { puts("ArgLink error: cannot grow list of WatchedFile named list->Files, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	}
+	WatchedFile* file = &list->Files[list->FileCount++];
+	file->Path = key;
+	StatWatchedFile(file);
+
+	key[directoryLength] = '\0';
+	for (size_t d = 0; d < list->DirectoryCount; d++) {
+		if (strcmp(list->Directories[d].Path, key) == 0) {
+			key[directoryLength] = '/';
+			return;
+		}
+	}
+	if (list->DirectoryCount >= list->DirectoryCapacity) {
+		list->DirectoryCapacity = (list->DirectoryCapacity > 0) ? list->DirectoryCapacity * 2 : 16;
+		list->Directories = (WatchedDirectory*)realloc(list->Directories, list->DirectoryCapacity * sizeof(WatchedDirectory)); if (list->Directories == NULL) { puts("ArgLink error: cannot grow list of WatchedDirectory named list->Directories, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	}
+	WatchedDirectory* directory = &list->Directories[list->DirectoryCount++];
+	directory->Path = (char*)calloc(directoryLength + 1, sizeof(char)); if (directory->Path == NULL) { puts("ArgLink error: cannot allocate for directory->Path of type char*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	memcpy(directory->Path, key, directoryLength);
+	key[directoryLength] = '/';
+	directory->Descriptor = -1;
+#if defined(__linux__)
+	if (list->Notify >= 0) {
+		directory->Descriptor = inotify_add_watch(list->Notify, (directoryLength > 0) ? directory->Path : "/", IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_ATTRIB);
+		if (directory->Descriptor < 0) {
+			printf("ArgLink warning: cannot watch directory %s, polling instead.\n", (directoryLength > 0) ? directory->Path : "/");
+			close(list->Notify);
+			list->Notify = -1;
+		}
+	}
+#endif
+}
+
+// Object files come from the command line, external files from the resident session and
+// from the last link when it failed
+WatchList* WatchListFor(char* const paths[], int32_t pathCount)
+{
+	WatchList* list = (WatchList*)calloc(1, sizeof(WatchList)); if (list == NULL) { puts("ArgLink error: cannot allocate for list of type WatchList*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	list->Index = ht_create(64); if (list->Index == NULL) { puts("ArgLink error: cannot allocate for list->Index of type ht*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	list->Notify = -1;
+#if defined(__linux__)
+	list->Notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+	for (int32_t i = 0; i < pathCount; i++) {
+		WatchFile(list, paths[i]);
+	}
+	if (s_residentSession != NULL) {
+		hti kvp = ht_iterator(s_residentSession->Externals); while (ht_next(&kvp)) {
+			WatchFile(list, kvp.key);
+		}
+	}
+	if (s_failedExternals != NULL) {
+		hti kvp = ht_iterator(s_failedExternals); while (ht_next(&kvp)) {
+			WatchFile(list, kvp.key);
+		}
+	}
+	return list;
+}
+
+void WatchListDestroy(WatchList* list)
+{
+	if (list->Notify >= 0) {
+		close(list->Notify);
+	}
+	for (size_t i = 0; i < list->FileCount; i++) {
+		free(list->Files[i].Path);
+	}
+	for (size_t d = 0; d < list->DirectoryCount; d++) {
+		free(list->Directories[d].Path);
+	}
+	free(list->Files);
+	free(list->Directories);
+	ht_destroy(list->Index);
+	free(list);
+}
+
+// Returns whether any watched file changed since the last call
+bool WatchedFilesChanged(WatchList* list)
+{
+	bool changed = false;
+#if defined(__linux__)
+	if (list->Notify >= 0) {
+		union {
+			struct inotify_event Event;
+			char Bytes[4096];
+		} buffer;
+		ssize_t got;
+		while ((got = read(list->Notify, buffer.Bytes, sizeof(buffer.Bytes))) > 0) {
+			for (ssize_t at = 0; at < got; ) {
+				const struct inotify_event* event = (const struct inotify_event*)(buffer.Bytes + at);
+				at += (ssize_t)(sizeof(struct inotify_event) + event->len);
+				if (event->mask & IN_Q_OVERFLOW) {
+					changed = true;
+					continue;
+				}
+				for (size_t d = 0; (d < list->DirectoryCount) && (event->len > 0); d++) {
+					if (list->Directories[d].Descriptor != event->wd) {
+						continue;
+					}
+					size_t directoryLength = strlen(list->Directories[d].Path);
+					size_t nameLength = strlen(event->name);
+					char* key = (char*)calloc(directoryLength + nameLength + 2, sizeof(char)); if (key == NULL) { puts("ArgLink error: cannot allocate for key of type char*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+					memcpy(key, list->Directories[d].Path, directoryLength);
+					key[directoryLength] = '/';
+					memcpy(key + directoryLength + 1, event->name, nameLength);
+					changed = changed || (ht_get(list->Index, key) != NULL);
+					free(key);
+				}
+			}
+		}
+		return changed;
+	}
+#endif
+	for (size_t i = 0; i < list->FileCount; i++) {
+		WatchedFile* file = &list->Files[i];
+		WatchedFile before = *file;
+		StatWatchedFile(file);
+		changed = changed || (file->FileSize != before.FileSize) || (file->ModifiedTime != before.ModifiedTime) ||
+			(file->ChangedTime != before.ChangedTime);
+	}
+	return changed;
+}
+
+int OpenWatchSocket(const char* path)
+{
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(address.sun_path)) { printf("ArgLink error: socket path %s is too long, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit((int)BadCLIUsage); }
+	memcpy(address.sun_path, path, strlen(path));
+	unlink(path);
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if ((listener < 0) || (bind(listener, (const struct sockaddr*)&address, sizeof(address)) != 0) || (listen(listener, 8) != 0)) {
+		printf("ArgLink error: cannot listen on socket %s, source code line " STRINGIZE(__LINE__) "\n", path); LinkExit(73);
+	}
+	return listener;
+}
+
+// Blocks until a watched file changed and writes settled, or a client asked for a link.
+// Returns the client, which gets the exit status of the link, or -1.
+int WaitForChange(WatchList* list, int listener)
+{
+	for (;;) {
+		struct pollfd ready[2];
+		ready[0].fd = list->Notify; ready[0].events = POLLIN; ready[0].revents = 0;
+		ready[1].fd = listener; ready[1].events = POLLIN; ready[1].revents = 0;
+		if (poll(ready, 2, (list->Notify >= 0) ? -1 : WATCH_POLL_MS) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			puts("ArgLink error: cannot wait for file changes, source code line " STRINGIZE(__LINE__)); LinkExit(70);
+		}
+		if (ready[1].revents & POLLIN) {
+			int client = accept(listener, NULL, NULL);
+			if (client >= 0) {
+				// The request itself carries nothing, any connection asks for a link
+				char request[256];
+				(void)recv(client, request, sizeof(request), MSG_DONTWAIT);
+				return client;
+			}
+		}
+		if (((list->Notify < 0) || (ready[0].revents & POLLIN)) && WatchedFilesChanged(list)) {
+			while ((list->Notify >= 0) && (poll(ready, 1, WATCH_SETTLE_MS) > 0)) {
+				(void)WatchedFilesChanged(list);
+			}
+			return -1;
+		}
+	}
+}
+
+// Frees what a link ended by an error owned. A relink is undone, unless it was being
+// committed: the session it left halfway is dropped, and the next link is a full one.
+void RecoverFromLinkError(void)
+{
+	Relink* relink = s_relinkInFlight;
+	if (relink != NULL) {
+		LinkSession* session = relink->Session;
+		bool committing = session->Changing;
+		RelinkDiscard(relink, session, !committing);
+		free(relink);
+		s_relinkInFlight = NULL;
+		if (committing) {
+			if (s_residentSession == session) {
+				s_residentSession = NULL;
+			}
+			if (s_inFlight.Session == session) {
+				s_inFlight.Session = NULL;
+			}
+			LinkSessionDestroy(session);
+		}
+	}
+
+	LinkInFlight* run = &s_inFlight;
+	if (run->Output != NULL) {
+		fclose(run->Output);
+	}
+	for (int32_t o = 0; (run->Objects != NULL) && (o < run->ObjectCount); o++) {
+		ReleaseObjectData(&run->Objects[o]);
+		FreeParsedObject(&run->Objects[o]);
+	}
+	free(run->Objects);
+	if (run->Link != NULL) {
+		SymbolTableDestroy(run->Link);
+	}
+	if (run->Rom != NULL) {
+		RomImageDestroy(run->Rom);
+	}
+	if (run->Externals != NULL) {
+		hti kvp = ht_iterator(run->Externals); while (ht_next(&kvp)) {
+			ht_set(s_failedExternals, kvp.key, s_failedExternals);
+		}
+		DestroyExternalFiles(run->Externals);
+	}
+	free(run->Patches);
+	if (run->Layout != NULL) {
+		RomLayoutDestroy(run->Layout);
+	}
+	if (run->Expressions != NULL) {
+		ExpressionTableDestroy(run->Expressions);
+	}
+	if ((run->Session != NULL) && (run->Session != s_residentSession)) {
+		LinkSessionDestroy(run->Session);
+	}
+	memset(run, 0, sizeof(LinkInFlight));
+	free(s_stats);
+	s_stats = NULL;
+}
+
+// Links once; an error ends the link, which returns its exit code, and not the watcher
+int WatchedLink(const LinkOptions* options)
+{
+	if (s_failedExternals != NULL) {
+		ht_destroy(s_failedExternals);
+	}
+	s_failedExternals = ht_create(16);
+	int exitCode = setjmp(s_linkRecovery);
+	if (exitCode == 0) {
+		s_linkRecoveryArmed = true;
+		exitCode = (int)LinkRom(options);
+	} else {
+		RecoverFromLinkError();
+	}
+	s_linkRecoveryArmed = false;
+	fflush(stdout);
+	return exitCode;
+}
+
+// Relinks until the process is killed
+void WatchAndRelink(const LinkOptions* options, const char* socketPath)
+{
+	signal(SIGPIPE, SIG_IGN);
+	// Errors jump back from the thread that met them, which must be this one
+	s_jobs = 1;
+	s_watching = true;
+	int listener = (socketPath != NULL) ? OpenWatchSocket(socketPath) : -1;
+	int client = -1;
+	WatchList* list = NULL;
+	for (;;) {
+		int exitCode = WatchedLink(options);
+
+		// Changes made before the new list watches are still queued on the old one, and count
+		WatchList* next = WatchListFor(options->Paths, options->PathCount);
+		bool pending = (list != NULL) && WatchedFilesChanged(list);
+		if (list != NULL) {
+			WatchListDestroy(list);
+		}
+		list = next;
+		if (client >= 0) {
+			char reply[16];
+			int length = snprintf(reply, sizeof(reply), "%d\n", exitCode);
+			(void)send(client, reply, (size_t)length, 0);
+			close(client);
+		}
+		printf("Watching %" PRIuPTR " file(s), last link exited with %d.\n", list->FileCount, exitCode);
+		fflush(stdout);
+		client = pending ? -1 : WaitForChange(list, listener);
+	}
+}
+#endif
+
+#pragma mark - Main entry point
+int main(int argc, char* argv[])
+{
+	// TODO : get, split and parse ALFLAGS environment variable
+	// Do it before parsing command line so command line can override environment
+
+	// Parse command line
+	// "Sob" is the default file extension for ArgSfxX output, not to insult anybody
+	int32_t idx;
+	bool* areSobs = (bool*)calloc((size_t)(argc - 1), sizeof(bool)); if (areSobs == NULL) { puts("ArgLink error: cannot allocate for areSobs of type bool*, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+	int32_t totalSobs = (argc - 1);
+	char* what;
+	bool hideLogo = false;
+	bool showPublics = false;
+	bool warnDupes = false;
+	char* romFile = NULL;
+	char* pubsPath = NULL;
+	char* passed;
+	uint8_t parsedU8;
+	uint16_t parsedU16;
+	bool hashSizeGiven = false;
+	char* statePath = NULL;
+	bool verifyFull = false;
+	char* snapshotIn = NULL;
+	char* snapshotOut = NULL;
+	bool watch = false;
+	char* watchSocket = NULL;
+	char* symbolDbPath = NULL;
+	char* lookupPath = NULL;
+	bool writeMap = false;
+	bool showBlocks = false;
+	uint16_t layoutKiB = 0;
+	char* freeMapPath = NULL;
+	char* statsPath = NULL;
+
+	// Fist pass only for the hideLogo switch, so any command line warning is shown after the logo
+	for (idx = 0; idx < (argc - 1); idx++) {
+		IsPositiveFlag('Q', argv[1 + idx], &hideLogo);
+		areSobs[idx] = true;
+	}
+	if (!hideLogo) {
+		OutputLogo();
+	}
+
+	for (idx = 0; idx < (argc - 1); idx++) {
+		passed = NULL;
+		parsedU8 = 0;
+		parsedU16 = 0;
+		what = argv[1 + idx];
+		if (IsPositiveFlag('V', what, &s_verbose) || IsPositiveFlag('Q', what, &hideLogo) ||
+			IsPositiveFlag('S', what, &showPublics) || IsPositiveFlag('C', what, &warnDupes) ||
+			IsPositiveFlag('U', what, &s_revalidateExternals) || IsPositiveFlag('G', what, &s_robinHood) ||
+			IsPositiveFlag('Z', what, &writeMap) || IsPositiveFlag('R', what, &showBlocks) ||
+			IsStringFlag('O', what, &romFile) || IsStringFlag('X', what, &pubsPath) ||
+			IsLongStringFlag("incremental", what, &statePath) || IsLongFlag("verify-full", what, &verifyFull) ||
+			IsLongStringFlag("load-snapshot", what, &snapshotIn) || IsLongStringFlag("save-snapshot", what, &snapshotOut) ||
+			IsLongStringFlag("symbol-db", what, &symbolDbPath) || IsLongStringFlag("lookup", what, &lookupPath) ||
+			IsLongStringFlag("free-map", what, &freeMapPath) || IsLongStringFlag("stats", what, &statsPath) ||
+			IsLongFlag("watch", what, &watch) || IsLongStringFlag("watch-socket", what, &watchSocket) ||
+			IsIgnoredFlag('D', what) || IsIgnoredFlag('N', what) || IsIgnoredFlag('Y', what) ||
+			IsIgnoredFlag('F', what) || IsIgnoredFlag('P', what) || IsIgnoredFlag('A', what)) {
+			areSobs[idx] = false;
+			totalSobs--;
+		} else if (IsStringFlag('E', what, &passed)) {
+			if ((passed != NULL) && (strlen(passed) >= 2) && (passed[0] == '.')) {
+				s_defaultExtension = passed;
+			} else {
+				puts("ArgLink warning: default extension override must start with a dot.");
+			}
+
+			areSobs[idx] = false;
+			totalSobs--;
+		} else if (IsStringFlag('W', what, &passed)) {
+			if (!((passed == NULL) || (strlen(passed) < 1))) {
 				if ((passed[strlen(passed) - 1] == '/') || (passed[strlen(passed) - 1] == '\\')) {
 					passed[strlen(passed) - 1] = '\0'; s_directoryPrefix = passed;
 				} else {
@@ -591,6 +4423,37 @@ int main(int argc, char* argv[])
 			status = IsUInt16Flag('H', what, 16, 65535, &parsedU16);
 			if (status == Valid) {
 				s_stringHashSize = parsedU16;
+				hashSizeGiven = true;
+				if (ht_round_capacity(parsedU16) != parsedU16) {
+					printf("ArgLink warning: option -H rounded up to %" PRIuPTR ".\n", ht_round_capacity(parsedU16));
+				}
+			}
+			if (status != Absent) {
+				areSobs[idx] = false;
+				totalSobs--;
+			}
+
+			status = IsByteFlag('K', what, HT_MIN_LOAD, HT_MAX_LOAD, &parsedU8);
+			if (status == Valid) {
+				s_stringHashLoad = parsedU8;
+			}
+			if (status != Absent) {
+				areSobs[idx] = false;
+				totalSobs--;
+			}
+
+			status = IsUInt16Flag('L', what, 1, 16384, &parsedU16);
+			if (status == Valid) {
+				layoutKiB = parsedU16;
+			}
+			if (status != Absent) {
+				areSobs[idx] = false;
+				totalSobs--;
+			}
+
+			status = IsByteFlag('J', what, 1, 64, &parsedU8);
+			if (status == Valid) {
+				s_jobs = parsedU8;
 			}
 			if (status != Absent) {
 				areSobs[idx] = false;
@@ -605,7 +4468,41 @@ int main(int argc, char* argv[])
 		}
 	}
 
-	if (totalSobs < 1) {
+	// Lookups take the place of object files, and there is no link
+	if (lookupPath != NULL) {
+		char** queries = (char**)calloc((size_t)totalSobs + 1, sizeof(char*)); if (queries == NULL) { puts("ArgLink error: cannot allocate for queries of type char**, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+		int32_t queryCount = 0;
+		for (idx = 0; idx < (argc - 1); idx++) {
+			if (areSobs[idx]) {
+				queries[queryCount++] = argv[1 + idx];
+			}
+		}
+		int32_t result = RunLookups(lookupPath, queries, queryCount);
+		free(queries);
+		return result;
+	}
+
+	if ((snapshotIn != NULL) && ((totalSobs > 0) || (statePath != NULL) || verifyFull)) {
+		puts("ArgLink warning: object files, --incremental and --verify-full are ignored with a snapshot.");
+		totalSobs = 0;
+		statePath = NULL;
+		verifyFull = false;
+	}
+	if ((snapshotIn != NULL) && watch) {
+		puts("ArgLink warning: --watch is ignored with a snapshot.");
+		watch = false;
+	}
+#ifndef ARGLINK_HAVE_WATCH
+	if (watch) {
+		puts("ArgLink warning: --watch is not available on this system, linking once.");
+		watch = false;
+	}
+#endif
+	if ((watchSocket != NULL) && !watch) {
+		puts("ArgLink warning: --watch-socket needs --watch.");
+	}
+
+	if ((totalSobs < 1) && (snapshotIn == NULL)) {
 		OutputUsage();
 		return (int32_t)BadCLIUsage;
 	} else if (((romFile == NULL) || (strlen(romFile) < 1))) {
@@ -613,89 +4510,36 @@ int main(int argc, char* argv[])
 		puts("ArgLink error: no ROM file was specified.");
 		return (int32_t)BadCLIUsage;
 	} else {
-		FILE* fileOut = fopen(romFile, "wb"); if (fileOut == NULL) { puts("ArgLink error: cannot open romFile in Write mode, source code line " STRINGIZE(__LINE__)); exit(73); }; size_t fileOutZone = (size_t)(s_ioBuffersKiB * 1024); char* fileOutBuffer = (fileOutZone > 0) ? (char*)calloc(fileOutZone, sizeof(char)) : NULL; setvbuf(fileOut, fileOutBuffer, fileOutBuffer ? _IOFBF : _IONBF, fileOutZone);
-		// Fill Output file to 1 MiB
-		puts("Constructing ROM Image.");
-		fseek(fileOut, 0, SEEK_SET);
-		for (idx = 0; idx < 0x100000; idx++) {
-			fputc(0xFF, fileOut);
-		}
-
-		// Steps 1 & 2: Input all data and list all links
-		puts("Processing Externals.");
-		ht* link = ht_create(s_stringHashSize);
-
-		int64_t* startLink = (int64_t*)calloc((size_t)totalSobs, sizeof(int64_t)); if (startLink == NULL) { puts("ArgLink error: cannot allocate for startLink of type int64_t*, source code line " STRINGIZE(__LINE__)); exit(70); }
-		int32_t firstSob = -1;
-		int32_t n = 0;
-		char* sobjFile;
-		for (idx = 0; idx < (argc - 1); idx++) {
-			if (areSobs[idx]) {
-				if (firstSob < 0) {
-					firstSob = idx;
-				}
-
-				//Check if SOB file is indeed a SOB file
-				sobjFile = AppendPrefixAndExtension(argv[1 + idx]);
-				FILE* fileSob = fopen(sobjFile, "rb"); if (fileSob == NULL) { puts("ArgLink error: cannot open sobjFile in Read mode, source code line " STRINGIZE(__LINE__)); exit(66); }; size_t fileSobZone = (size_t)(s_ioBuffersKiB * 1024); char* fileSobBuffer = (fileSobZone > 0) ? (char*)calloc(fileSobZone, sizeof(char)) : NULL; setvbuf(fileSob, fileSobBuffer, fileSobBuffer ? _IOFBF : _IONBF, fileSobZone);
-				LuigiFormat("Open %s\n", sobjFile);
-				fseek(fileSob, 0, SEEK_SET);
-				if (SOBJWasRead(fileSob)) {
-					if (fgetc(fileSob) == EOF) { puts("ArgLink error: reading byte from fileSob failed, source code line " STRINGIZE(__LINE__)); exit(74); };
-					if (fgetc(fileSob) == EOF) { puts("ArgLink error: reading byte from fileSob failed, source code line " STRINGIZE(__LINE__)); exit(74); };
-					int32_t count = fgetc(fileSob); if (count == EOF) { puts("ArgLink error: reading byte from fileSob failed, source code line " STRINGIZE(__LINE__)); exit(74); };
-					if (fgetc(fileSob) == EOF) { puts("ArgLink error: reading byte from fileSob failed, source code line " STRINGIZE(__LINE__)); exit(74); };
-
-					for (int32_t i = 0; i < count; i++) {
-						// Step 1: Input all data into output
-						InputSobStepOne(i, fileOut, fileSob);
-					}
-
-					// Step 2: Get all extern names and values
-					InputSobStepTwo(link, sobjFile, fileSob, warnDupes);
-
-					startLink[n] = ftell(fileSob);
-					n++;
-					fclose(fileSob); free(fileSobBuffer);
-					//Repeat
-				}
-			}
-		}
-
-		if (showPublics) {
-			puts("Public Symbols Defined:");
-			// FIXME : In original ArgLink, symbol output is sorted by symbol name
-			hti kvp = ht_iterator(link); while (ht_next(&kvp)) {
-				printf("FILE: %-17s -- SYMBOL: %-30s -- VALUE: %6" PRIX32 "\n", ((LinkData*)kvp.value)->Origin, kvp.key, ((LinkData*)kvp.value)->Value);
-			}
-		}
-
-		// Step 3: Link everything
-		puts("Writing Image.");
-		LuigiOut("----LINK");
-		n = 0;
-		for (idx = firstSob; idx < (argc - 1); idx++) {
+		LinkOptions options;
+		memset(&options, 0, sizeof(options));
+		options.RomFile = romFile;
+		options.PubsPath = pubsPath;
+		options.StatePath = statePath;
+		options.SnapshotIn = snapshotIn;
+		options.SnapshotOut = snapshotOut;
+		options.SymbolDbPath = symbolDbPath;
+		options.FreeMapPath = freeMapPath;
+		options.StatsPath = statsPath;
+		options.ShowPublics = showPublics;
+		options.WarnDupes = warnDupes;
+		options.HashSizeGiven = hashSizeGiven;
+		options.VerifyFull = verifyFull;
+		options.WriteMap = writeMap;
+		options.ShowBlocks = showBlocks;
+		options.LayoutKiB = layoutKiB;
+		options.Paths = (char**)calloc((size_t)totalSobs + 1, sizeof(char*)); if (options.Paths == NULL) { puts("ArgLink error: cannot allocate for options.Paths of type char**, source code line " STRINGIZE(__LINE__)); LinkExit(70); }
+		for (idx = 0; (snapshotIn == NULL) && (idx < (argc - 1)); idx++) {
 			if (areSobs[idx]) {
-				sobjFile = AppendPrefixAndExtension(argv[1 + idx]);
-				PerformLink(link, sobjFile, fileOut, startLink, n);
-				n++;
+				options.Paths[options.PathCount++] = AppendPrefixAndExtension(argv[1 + idx]);
 			}
 		}
-
-		fseek(fileOut, 0, SEEK_END); int64_t finalSize = ftell(fileOut);
-		finalSize = (finalSize / 1024) + ((finalSize % 1024) > 0 ? 1 : 0);
-		printf("| Publics: %" PRIuPTR "\tFiles: %" PRId32 "\tROM Size: %" PRId64 "KiB |\n", ht_length(link), totalSobs, finalSize);
-
-		fclose(fileOut); free(fileOutBuffer);
-
-		if (!((pubsPath == NULL) || (strlen(pubsPath) < 1))) {
-			FILE* filePubs = fopen(pubsPath, "wb"); if (filePubs == NULL) { puts("ArgLink error: cannot open pubsPath in Write mode, source code line " STRINGIZE(__LINE__)); exit(73); }; size_t filePubsZone = (size_t)(s_ioBuffersKiB * 1024); char* filePubsBuffer = (filePubsZone > 0) ? (char*)calloc(filePubsZone, sizeof(char)) : NULL; setvbuf(filePubs, filePubsBuffer, filePubsBuffer ? _IOFBF : _IONBF, filePubsZone);
-			hti kvp = ht_iterator(link); while (ht_next(&kvp)) {
-				fprintf(filePubs, "%s\n", kvp.key);
-			}
-			fclose(filePubs); free(filePubsBuffer);
+#ifdef ARGLINK_HAVE_WATCH
+		if (watch) {
+			WatchAndRelink(&options, watchSocket);
 		}
-
-		return (int32_t)Success;
+#endif
+		int32_t result = LinkRom(&options);
+		free(options.Paths);
+		return result;
 	}
 }
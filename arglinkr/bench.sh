@@ -0,0 +1,37 @@
+#!/bin/sh
+# End-to-end link benchmark, run by "make bench": links corpora of growing size made by
+# sobgen and reports throughput from the --stats report of the fastest of RUNS links.
+# BENCH_SCALES (object counts), BENCH_RUNS and BENCH_JOBS (-J) can be set in the environment.
+set -e
+SCALES=${BENCH_SCALES:-"100 1000 4000"}
+RUNS=${BENCH_RUNS:-3}
+JOBS=${BENCH_JOBS:-1}
+
+echo "Link benchmark, -J$JOBS, best of $RUNS"
+printf "%8s %10s %12s %15s %10s\n" objects wall_ms objects/s relocations/s MiB/s
+for objects in $SCALES; do
+	corpus=bench/$objects
+	if [ ! -f "$corpus/list" ]; then
+		mkdir -p "$corpus"
+		./sobgen --objects="$objects" --seed=1 --dir="$corpus" > "$corpus/list"
+	fi
+	best=""
+	run=0
+	while [ "$run" -lt "$RUNS" ]; do
+		./arglinkr -Q -O"$corpus/bench.rom" -J"$JOBS" --stats="$corpus/stats.json" $(cat "$corpus/list") > /dev/null
+		wall=$(sed -n 's/^  "wall_ms": \([0-9.]*\),$/\1/p' "$corpus/stats.json")
+		if [ -z "$best" ] || awk "BEGIN { exit !($wall < $best) }"; then
+			best=$wall
+			cp "$corpus/stats.json" "$corpus/best.json"
+		fi
+		run=$((run + 1))
+	done
+	awk -v objects="$objects" '
+		/"bytes_read":/ { sub(/.*"bytes_read": /, ""); sub(/,.*/, ""); bytes += $0 }
+		/^  "wall_ms":/ { gsub(/[^0-9.]/, ""); wall = $0 }
+		/"relocations_applied":/ { gsub(/[^0-9]/, ""); relocations = $0 }
+		END {
+			seconds = wall / 1000
+			printf "%8d %10.2f %12.0f %15.0f %10.1f\n", objects, wall, objects / seconds, relocations / seconds, bytes / 1048576 / seconds
+		}' "$corpus/best.json"
+done
@@ -0,0 +1,168 @@
+#!/bin/sh
+# Regression checks, run by "make check": links small sobgen corpora in several ways and
+# compares the ROMs with those of a plain link. Work files are kept in bench/check.
+# Needs a POSIX shell and cmp.
+HERE=$(cd "$(dirname "$0")" && pwd)
+WORK=$HERE/bench/check
+LINK="$HERE/arglinkr -Q"
+
+rm -rf "$WORK"
+mkdir -p "$WORK"
+cd "$WORK" || exit 70
+"$HERE/sobgen" --objects=20 --seed=7 > list || exit 70
+# Replacements for objects and external files, and an object 0 with more and fewer publics
+mkdir other more fewer
+"$HERE/sobgen" --objects=20 --seed=8 --dir=other > /dev/null || exit 70
+"$HERE/sobgen" --objects=1 --seed=9 --publics=60 --dir=more > /dev/null || exit 70
+"$HERE/sobgen" --objects=1 --seed=10 --publics=50 --dir=fewer > /dev/null || exit 70
+# One-section objects without relocations: obj1 of narrow starts within obj0 of wide
+mkdir narrow wide
+"$HERE/sobgen" --objects=2 --sections=1 --section-size=1024 --relocations=0 --seed=11 --dir=narrow > /dev/null || exit 70
+"$HERE/sobgen" --objects=1 --sections=1 --section-size=2048 --relocations=0 --seed=12 --dir=wide > /dev/null || exit 70
+# Relocations with long, deeply nested expressions
+mkdir deep
+"$HERE/sobgen" --objects=10 --terms=8 --depth=5 --relocations=400 --seed=13 --dir=deep > deep/list || exit 70
+# Many relocations of one-term expressions over few publics, evaluated mostly from the memo
+mkdir shared
+"$HERE/sobgen" --objects=10 --terms=1 --depth=1 --publics=5 --relocations=1000 --seed=14 --dir=shared > shared/list || exit 70
+# Relocations of which 30 percent patch bytes that others patch too
+mkdir overlapping
+"$HERE/sobgen" --objects=10 --overlaps=30 --seed=15 --dir=overlapping > overlapping/list || exit 70
+# Not an object file: the linker skips it, as the original did
+printf 'NOTASOB' > junk.sob
+
+failures=0
+pass()
+{
+	echo "ok      $1"
+}
+fail()
+{
+	echo "FAILED  $1"
+	failures=$((failures + 1))
+}
+
+# same_rom <name> <rom>: the ROM must be the one of the plain link
+same_rom()
+{
+	if cmp -s full.rom "$2"; then pass "$1"; else fail "$1"; fi
+}
+
+# known_rom <name> <rom> <checksum>: the ROM must have the cksum it had with the original linker
+known_rom()
+{
+	if [ "$(cksum < "$2")" = "$3 1048576" ]; then pass "$1"; else fail "$1"; fi
+}
+
+$LINK -Ofull.rom $(cat list) junk.sob > full.log || { cat full.log; exit 70; }
+
+# Expressions evaluate exactly as the original repeated scans did
+if $LINK -Odeep.rom $(cat deep/list) > deep.log; then
+	known_rom "deeply nested relocation expressions" deep.rom 1895541635
+else
+	fail "deeply nested relocation expressions"
+fi
+
+# An interned expression gives each symbol its own value
+if $LINK -Oshared.rom $(cat shared/list) > shared.log; then
+	known_rom "memoized relocation expressions" shared.rom 4002717981
+else
+	fail "memoized relocation expressions"
+fi
+
+# Sorted patches still apply in relocation order, and -C lists the offsets the warning counts
+if $LINK -Ooverlapping.rom $(cat overlapping/list) > overlapping.log &&
+	grep -q "relocations overlap at 51 ROM offset(s), -C lists them" overlapping.log &&
+	$LINK -C -Olisted.rom $(cat overlapping/list) > listed.log &&
+	[ "$(grep -c "relocations overlap at ROM offset" listed.log)" -eq 51 ]; then
+	known_rom "overlapping relocation patches" overlapping.rom 896544830
+else
+	fail "overlapping relocation patches"
+fi
+
+# A snapshot of a link with a non-SOBJ input loads back
+if $LINK -Osaved.rom --save-snapshot=with-junk.bin $(cat list) junk.sob > saved.log &&
+	$LINK -Oloaded.rom --load-snapshot=with-junk.bin > loaded.log; then
+	same_rom "snapshot with a non-SOBJ input" loaded.rom
+else
+	fail "snapshot with a non-SOBJ input"
+fi
+
+# A section starting first but written last is the one that overwrites
+if $LINK -Ooverlap.rom narrow/obj1.sob wide/obj0.sob > overlap.log &&
+	grep -q "section 0 of wide/obj0.sob overwrites section 0 of narrow/obj1.sob at ROM offset 400 to 7FF" overlap.log; then
+	pass "overlap written in reverse start order"
+else
+	fail "overlap written in reverse start order"
+fi
+
+# The symbol database answers names as -S prints them, and an address range holds every public
+if $LINK -S -Osymbols.rom --symbol-db=symbols.db -Xpublics.txt $(cat list) > symbols.log &&
+	grep "^FILE: " symbols.log > shown.txt &&
+	$LINK --lookup=symbols.db < publics.txt > names.txt && cmp -s shown.txt names.txt &&
+	[ "$($LINK --lookup=symbols.db @0-FFFFFF | grep -c "^FILE: ")" -eq "$(wc -l < publics.txt)" ] &&
+	! $LINK --lookup=symbols.db NO_SUCH_PUBLIC > missing.txt; then
+	pass "symbol database lookups"
+else
+	fail "symbol database lookups"
+fi
+
+# The MAP file lists the 80 sections by offset, then the publics -S shows by address
+if $LINK -S -Z -Omapped.rom $(cat list) > mapped.log &&
+	awk '/^Sections:/ { s = 1; next } /^$/ { s = 0 } s && ($1 != "OFFSET") { print $1 }' mapped.map > map-sections.txt &&
+	[ "$(wc -l < map-sections.txt)" -eq 80 ] && LC_ALL=C sort -c map-sections.txt &&
+	awk '/^Publics by address:/ { p = 1; next } p && ($1 != "VALUE") { print $1, $2 }' mapped.map > map-publics.txt &&
+	LC_ALL=C sort -c -k1,1 map-publics.txt &&
+	awk '/^FILE: / { v = $8; while (length(v) < 6) v = "0" v; print v, $5 }' mapped.log | LC_ALL=C sort > shown-publics.txt &&
+	LC_ALL=C sort map-publics.txt | cmp -s shown-publics.txt -; then
+	pass "debugger MAP file"
+else
+	fail "debugger MAP file"
+fi
+
+# -L maps the used KiB and -R merges adjacent sections into one block, without an overlap warning
+if $LINK -L4 -R -Olayout.rom narrow/obj1.sob > gap.log &&
+	grep -q "^BANK 00: \.#\.\.   1024 byte(s) used" gap.log &&
+	grep -q "^BLOCK: 000400-0007FF -- SIZE:    400 -- SECTIONS: 1" gap.log &&
+	$LINK -L4 -R -Olayout.rom narrow/obj0.sob narrow/obj1.sob > adjacent.log &&
+	grep -q "^BANK 00: ##\.\.   2048 byte(s) used" adjacent.log &&
+	grep -q "^BLOCK: 000000-0007FF -- SIZE:    800 -- SECTIONS: 2" adjacent.log &&
+	! grep -q "overwrites" adjacent.log; then
+	pass "ROM layout and blocks"
+else
+	fail "ROM layout and blocks"
+fi
+
+# relink <name> <message> <objects...>: an incremental link must print the message, pass
+# --verify-full and give the ROM of a full link of the same objects
+relink()
+{
+	name=$1
+	message=$2
+	shift 2
+	if $LINK -Oinc.rom --incremental=state.bin --verify-full "$@" > inc.log && grep -q "$message" inc.log &&
+		$LINK -Ofull.rom "$@" > full.log; then
+		same_rom "$name" inc.rom
+	else
+		fail "$name"
+	fi
+}
+
+relink "incremental link without state" "Linking all 21 object(s): no link state" $(cat list) junk.sob
+relink "incremental link, nothing changed" "Reusing 21 unchanged object(s) of 21" $(cat list) junk.sob
+touch obj3.sob
+relink "incremental link, object touched" "Reusing 21 unchanged object(s) of 21" $(cat list) junk.sob
+cp other/obj3.sob obj3.sob
+relink "incremental link, object changed" "Reusing 20 unchanged object(s) of 21" $(cat list) junk.sob
+cp other/ext2.bin ext2.bin
+relink "incremental link, external file changed" "Reusing 21 unchanged object(s) of 21" $(cat list) junk.sob
+cp other/obj5.sob extra.sob
+relink "incremental link, object appended" "Reusing 21 unchanged object(s) of 22" $(cat list) junk.sob extra.sob
+cp more/obj0.sob obj0.sob
+relink "incremental link, publics added" "Reusing 21 unchanged object(s) of 22" $(cat list) junk.sob extra.sob
+cp fewer/obj0.sob obj0.sob
+relink "incremental link, publics removed" "Reusing 21 unchanged object(s) of 22" $(cat list) junk.sob extra.sob
+relink "incremental link, object removed" "Linking all 21 object(s): objects were removed" $(cat list) junk.sob
+
+echo "$failures check(s) failed"
+[ "$failures" -eq 0 ]
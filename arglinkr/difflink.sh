@@ -0,0 +1,118 @@
+#!/bin/sh
+# Differential link harness, run by "make difflink": links the same SOB sets with arglinkr
+# and with the C# reference in ../ARGLINK_REWRITE, compares the ROMs with romdiff and
+# reports the best wall time of RUNS links for each.
+# Without arguments, links sobgen corpora of DIFF_SCALES objects for each of DIFF_SEEDS;
+# with arguments, links them as given (objects and options) in the current directory.
+# The reference is built with the .NET SDK, or else Mono; DIFF_REFERENCE can instead name
+# a command that runs it. Reference times include the runtime startup.
+# Needs a POSIX shell and a date command that knows %N (GNU or BusyBox).
+set -e
+HERE=$(cd "$(dirname "$0")" && pwd)
+SCALES=${DIFF_SCALES:-"100 1000"}
+SEEDS=${DIFF_SEEDS:-"1 2 3"}
+RUNS=${DIFF_RUNS:-3}
+WORK=$HERE/bench/difflink
+
+case $(date +%N) in
+	*[!0-9]*|"") echo "difflink: date cannot print nanoseconds here."; exit 69 ;;
+esac
+
+# Build the reference once; its old-style project targets .NET Framework 2.0, so the SDK
+# gets a project of its own that compiles the same Program.cs
+mkdir -p "$WORK"
+if [ -n "$DIFF_REFERENCE" ]; then
+	REFERENCE=$DIFF_REFERENCE
+elif command -v dotnet > /dev/null 2>&1; then
+	framework=net$(dotnet --version | cut -d. -f1).0
+	mkdir -p "$WORK/reference"
+	cat > "$WORK/reference/ARGLINK_REWRITE.csproj" <<EOF
+<Project Sdk="Microsoft.NET.Sdk">
+  <PropertyGroup>
+    <OutputType>Exe</OutputType>
+    <TargetFramework>$framework</TargetFramework>
+    <EnableDefaultCompileItems>false</EnableDefaultCompileItems>
+    <Nullable>disable</Nullable>
+    <InvariantGlobalization>true</InvariantGlobalization>
+    <TieredPGO>true</TieredPGO>
+  </PropertyGroup>
+  <ItemGroup>
+    <Compile Include="$HERE/../ARGLINK_REWRITE/Program.cs" />
+  </ItemGroup>
+</Project>
+EOF
+	dotnet build -nologo -v quiet -c Release -o "$WORK/reference/bin" "$WORK/reference/ARGLINK_REWRITE.csproj" > "$WORK/reference/build.log" ||
+		{ cat "$WORK/reference/build.log"; exit 70; }
+	REFERENCE="dotnet $WORK/reference/bin/ARGLINK_REWRITE.dll"
+elif command -v mcs > /dev/null 2>&1 && command -v mono > /dev/null 2>&1; then
+	mcs -nologo -optimize+ -out:"$WORK/ARGLINK_REWRITE.exe" "$HERE/../ARGLINK_REWRITE/Program.cs"
+	REFERENCE="mono $WORK/ARGLINK_REWRITE.exe"
+else
+	echo "difflink: neither the .NET SDK nor Mono is installed; set DIFF_REFERENCE to run the reference."
+	exit 69
+fi
+
+now_ms()
+{
+	echo $(( $(date +%s%N) / 1000000 ))
+}
+
+# link <name> <objects and options...>: best times of both linkers, then the ROM comparison
+link()
+{
+	name=$1
+	shift
+	best_c=""
+	best_reference=""
+	run=0
+	while [ "$run" -lt "$RUNS" ]; do
+		# The reference opens the ROM without truncating it
+		rm -f "$WORK/$name.c.rom" "$WORK/$name.reference.rom"
+		start=$(now_ms)
+		"$HERE/arglinkr" -Q -O"$WORK/$name.c.rom" "$@" > "$WORK/$name.c.log" ||
+			{ echo "arglinkr failed on $name:"; cat "$WORK/$name.c.log"; return 1; }
+		elapsed=$(( $(now_ms) - start ))
+		if [ -z "$best_c" ] || [ "$elapsed" -lt "$best_c" ]; then best_c=$elapsed; fi
+		start=$(now_ms)
+		$REFERENCE -Q -O"$WORK/$name.reference.rom" "$@" > "$WORK/$name.reference.log" 2>&1 ||
+			{ echo "The reference failed on $name:"; cat "$WORK/$name.reference.log"; return 1; }
+		elapsed=$(( $(now_ms) - start ))
+		if [ -z "$best_reference" ] || [ "$elapsed" -lt "$best_reference" ]; then best_reference=$elapsed; fi
+		run=$((run + 1))
+	done
+	if "$HERE/romdiff" "$WORK/$name.reference.rom" "$WORK/$name.c.rom" > "$WORK/$name.diff"; then
+		verdict=identical
+	else
+		verdict=DIFFERENT
+	fi
+	speedup=$(awk "BEGIN { printf \"%.1f\", $best_reference / ($best_c > 0 ? $best_c : 1) }")
+	printf "%-16s %10s %10s %8s  %s\n" "$name" "$best_c" "$best_reference" "${speedup}x" "$verdict"
+	if [ "$verdict" = DIFFERENT ]; then
+		# romdiff reads the objects to name the owners; options are not files
+		objects=""
+		for argument in "$@"; do
+			if [ -f "$argument" ]; then objects="$objects $argument"; fi
+		done
+		"$HERE/romdiff" "$WORK/$name.reference.rom" "$WORK/$name.c.rom" $objects || true
+		return 1
+	fi
+}
+
+echo "Differential link, reference: $REFERENCE, best of $RUNS"
+printf "%-16s %10s %10s %8s  %s\n" corpus c_ms reference_ms speedup ROM
+status=0
+if [ $# -gt 0 ]; then
+	link given "$@" || status=1
+else
+	for objects in $SCALES; do
+		for seed in $SEEDS; do
+			corpus=$WORK/$objects-$seed
+			if [ ! -f "$corpus/list" ]; then
+				mkdir -p "$corpus"
+				"$HERE/sobgen" --objects="$objects" --seed="$seed" --dir="$corpus" > "$corpus/list"
+			fi
+			link "$objects-$seed" $(cat "$corpus/list") || status=1
+		done
+	done
+fi
+exit $status
@@ -19,21 +19,54 @@
 typedef struct {
     const char* key;  // key is NULL if this slot is empty
     void* value;
+    uint64_t hash;    // full hash of key, compared before the key itself
 } ht_entry;
 
+// Block of the key arena. Keys are copied back to back into large blocks
+// instead of one allocation each, and all blocks are freed by ht_destroy.
+typedef struct ht_block {
+    struct ht_block* next;  // previously filled block, or NULL
+    size_t used;            // bytes of chars already taken
+    size_t capacity;        // size of chars array
+    char chars[];
+} ht_block;
+
+#define HT_BLOCK_SIZE 65536
+
 // Hash table structure: create with ht_create, free with ht_destroy.
 struct ht {
     ht_entry* entries;  // hash slots
-    size_t capacity;    // size of _entries array
+    size_t capacity;    // size of _entries array, always a power of two
     size_t length;      // number of items in hash table
+    ht_block* blocks;   // key arena, most recent block first
+    ht_layout layout;   // probing scheme
+    unsigned max_load;  // percentage of capacity filled before expanding
 };
 
+size_t ht_round_capacity(size_t capacity)
+{
+    size_t rounded = 1;
+    while ((rounded < capacity) && (rounded * 2 > rounded)) {
+        rounded *= 2;
+    }
+    return rounded;
+}
+
 ht* ht_create(size_t initialCapacity)
+{
+    return ht_create_with(initialCapacity, HT_LINEAR, HT_DEFAULT_LOAD);
+}
+
+ht* ht_create_with(size_t initialCapacity, ht_layout layout, unsigned max_load_percent)
 {
     if (initialCapacity <= 0) {
         puts("ht error: initialCapacity is less than 1, source code line " STRINGIZE(__LINE__));
         exit(EX_SOFTWARE);
     }
+    if ((max_load_percent < HT_MIN_LOAD) || (max_load_percent > HT_MAX_LOAD)) {
+        puts("ht error: maximum load is out of range, source code line " STRINGIZE(__LINE__));
+        exit(EX_SOFTWARE);
+    }
 
     // Allocate space for hash table struct.
     ht* table = (ht*)calloc(1, sizeof(ht));
@@ -42,7 +75,10 @@ ht* ht_create(size_t initialCapacity)
         exit(EX_SOFTWARE);
     }
     table->length = 0;
-    table->capacity = initialCapacity;
+    // Slots are found by masking the hash, so the capacity must be a power of two.
+    table->capacity = ht_round_capacity(initialCapacity);
+    table->layout = layout;
+    table->max_load = max_load_percent;
 
     // Allocate (zeroed) space for entry buckets.
     table->entries = (ht_entry*)calloc(table->capacity, sizeof(ht_entry));
@@ -56,9 +92,12 @@ ht* ht_create(size_t initialCapacity)
 
 void ht_destroy(ht* table)
 {
-    // First free allocated keys.
-    for (size_t i = 0; i < table->capacity; i++) {
-        free((void*)table->entries[i].key);
+    // First free key arena blocks.
+    ht_block* block = table->blocks;
+    while (block != NULL) {
+        ht_block* next = block->next;
+        free(block);
+        block = next;
     }
 
     // Then free entries array and table itself.
@@ -66,74 +105,117 @@ void ht_destroy(ht* table)
     free(table);
 }
 
-// Return 64-bit FNV-1a hash for key (NUL-terminated). See description:
+// Return 64-bit FNV-1a hash for key of given length. See description:
 // https://en.wikipedia.org/wiki/Fowler-Noll-Vo_hash_function
-static uint64_t hash_key(const char* key)
+uint64_t ht_hash(const char* key, size_t length)
 {
     uint64_t hash = 1469598103934665603ULL;
-    for (const char* p = key; *p; p++) {
-        hash ^= (uint64_t)(unsigned char)(*p);
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint64_t)(unsigned char)(key[i]);
         hash *= 1099511628211ULL;
     }
     return hash;
 }
 
-void* ht_get(const ht* table, const char* key)
+// Internal function to test whether a slot holds the given key.
+static bool ht_matches(const ht_entry* entry, const char* key, size_t length, uint64_t hash)
 {
-    // AND hash with capacity-1 to ensure it's within entries array.
-    uint64_t hash = hash_key(key);
-    size_t index = (size_t)(hash & (uint64_t)(table->capacity - 1));
+    return (entry->hash == hash) && (memcmp(key, entry->key, length) == 0) && (entry->key[length] == '\0');
+}
 
-    // Loop till we find an empty entry.
-    while (table->entries[index].key != NULL) {
-        if (strcmp(key, table->entries[index].key) == 0) {
-            // Found key, return value.
-            return table->entries[index].value;
-        }
-        // Key wasn't in this slot, move to next (linear probing).
-        index++;
-        if (index >= table->capacity) {
-            // At end of entries array, wrap around.
-            index = 0;
-        }
-    }
-    return NULL;
+// Internal function returning how far the entry at index is from its home slot.
+static size_t ht_distance(const ht_entry* entry, size_t index, size_t capacity)
+{
+    return (index - (size_t)(entry->hash & (uint64_t)(capacity - 1))) & (capacity - 1);
 }
 
-// Internal function to set an entry (without expanding table).
-static const char* ht_set_entry(ht_entry* entries, size_t capacity, const char* key, void* value, size_t* plength)
+// Internal function to find the slot of key, or return capacity if absent.
+static size_t ht_find_slot(const ht* table, const char* key, size_t length, uint64_t hash)
 {
     // AND hash with capacity-1 to ensure it's within entries array.
-    uint64_t hash = hash_key(key);
+    size_t capacity = table->capacity;
     size_t index = (size_t)(hash & (uint64_t)(capacity - 1));
 
-    // Loop till we find an empty entry.
-    while (entries[index].key != NULL) {
-        if (strcmp(key, entries[index].key) == 0) {
-            // Found key (it already exists), update value.
-            entries[index].value = value;
-            return entries[index].key;
+    // Loop till we find the key or an empty entry.
+    for (size_t distance = 0; table->entries[index].key != NULL; distance++) {
+        const ht_entry* entry = &table->entries[index];
+        if (ht_matches(entry, key, length, hash)) {
+            return index;
+        }
+        // With Robin Hood, a richer entry means the key would have displaced it.
+        if ((table->layout == HT_ROBIN_HOOD) && (ht_distance(entry, index, capacity) < distance)) {
+            break;
         }
         // Key wasn't in this slot, move to next (linear probing).
-        index++;
-        if (index >= capacity) {
-            // At end of entries array, wrap around.
-            index = 0;
+        index = (index + 1) & (capacity - 1);
+    }
+    return capacity;
+}
+
+// Internal function to place an entry whose key is known to be absent, without
+// expanding table. Return the slot where the new entry ended.
+static size_t ht_place(ht_entry* entries, size_t capacity, ht_layout layout, ht_entry entry)
+{
+    size_t index = (size_t)(entry.hash & (uint64_t)(capacity - 1));
+    size_t placed = capacity;
+    size_t distance = 0;
+    while (entries[index].key != NULL) {
+        // Robin Hood: take the slot from an entry closer to its home, then carry that one on.
+        if (layout == HT_ROBIN_HOOD) {
+            size_t existing = ht_distance(&entries[index], index, capacity);
+            if (existing < distance) {
+                ht_entry displaced = entries[index];
+                entries[index] = entry;
+                if (placed == capacity) {
+                    placed = index;
+                }
+                entry = displaced;
+                distance = existing;
+            }
         }
+        index = (index + 1) & (capacity - 1);
+        distance++;
     }
+    entries[index] = entry;
+    return (placed == capacity) ? index : placed;
+}
+
+void* ht_get_hashed(const ht* table, const char* key, size_t length, uint64_t hash)
+{
+    size_t index = ht_find_slot(table, key, length, hash);
+    return (index < table->capacity) ? table->entries[index].value : NULL;
+}
+
+void* ht_get(const ht* table, const char* key)
+{
+    size_t length = strlen(key);
+    return ht_get_hashed(table, key, length, ht_hash(key, length));
+}
 
-    // Didn't find key, allocate+copy if needed, then insert it.
-    if (plength != NULL) {
-        key = strdup(key);
-        if (key == NULL) {
-            puts("ht error: cannot allocate key for new entry, source code line " STRINGIZE(__LINE__));
+// Internal function to copy a key into the arena.
+static const char* ht_intern(ht* table, const char* key, size_t length)
+{
+    size_t size = length + 1;
+    ht_block* block = table->blocks;
+    if ((block == NULL) || (block->capacity - block->used < size)) {
+        // Oversized keys get a block of their own.
+        size_t capacity = (size > HT_BLOCK_SIZE) ? size : HT_BLOCK_SIZE;
+        block = (ht_block*)malloc(sizeof(ht_block) + capacity);
+        if (block == NULL) {
+            puts("ht error: cannot allocate key arena block, source code line " STRINGIZE(__LINE__));
             exit(EX_SOFTWARE);
         }
-        (*plength)++;
+        block->used = 0;
+        block->capacity = capacity;
+        block->next = table->blocks;
+        table->blocks = block;
     }
-    entries[index].key = (char*)key;
-    entries[index].value = value;
-    return key;
+
+    char* copy = block->chars + block->used;
+    memcpy(copy, key, length);
+    copy[length] = '\0';
+    block->used += size;
+    return copy;
 }
 
 // Expand hash table to twice its current size. Return true on success,
@@ -151,10 +233,11 @@ static bool ht_expand(ht* table)
     }
 
     // Iterate entries, move all non-empty ones to new table's entries.
+    // Keys are unique and their hashes are cached, so only empty slots are probed.
     for (size_t i = 0; i < table->capacity; i++) {
         ht_entry entry = table->entries[i];
         if (entry.key != NULL) {
-            ht_set_entry(new_entries, new_capacity, entry.key, entry.value, NULL);
+            ht_place(new_entries, new_capacity, table->layout, entry);
         }
     }
 
@@ -165,20 +248,103 @@ static bool ht_expand(ht* table)
     return true;
 }
 
-const char* ht_set(ht* table, const char* key, void* value)
+// Internal function shared by ht_upsert_hashed and ht_get_or_insert_hashed:
+// a key already present gets value only when replace is true.
+static void* ht_probe_insert(ht* table, const char* key, size_t length, uint64_t hash, void* value, bool replace, const char** stored_key)
 {
     if (value == NULL) {
         return NULL;
     }
 
-    // If length will exceed three quarters of current capacity, expand it.
-    if ((table->length >= table->capacity / 4 * 3) && (!ht_expand(table))) {
+    size_t index = ht_find_slot(table, key, length, hash);
+    if (index < table->capacity) {
+        // Found key (it already exists), update value if asked to.
+        ht_entry* entry = &table->entries[index];
+        void* previous = entry->value;
+        if (replace) {
+            entry->value = value;
+        }
+        if (stored_key != NULL) {
+            *stored_key = entry->key;
+        }
+        return previous;
+    }
+
+    // If length will exceed the maximum load of current capacity, expand it.
+    if ((table->length >= table->capacity * table->max_load / 100) && (!ht_expand(table))) {
         puts("ht error: cannot expand capacity, source code line " STRINGIZE(__LINE__));
         exit(EX_SOFTWARE);
     }
 
-    // Set entry and update length.
-    return ht_set_entry(table->entries, table->capacity, key, value, &table->length);
+    // Didn't find key, copy it to the arena, then insert it.
+    ht_entry entry;
+    entry.key = ht_intern(table, key, length);
+    entry.value = value;
+    entry.hash = hash;
+    ht_place(table->entries, table->capacity, table->layout, entry);
+    table->length++;
+    if (stored_key != NULL) {
+        *stored_key = entry.key;
+    }
+    return NULL;
+}
+
+void* ht_upsert_hashed(ht* table, const char* key, size_t length, uint64_t hash, void* value, const char** stored_key)
+{
+    return ht_probe_insert(table, key, length, hash, value, true, stored_key);
+}
+
+void* ht_get_or_insert_hashed(ht* table, const char* key, size_t length, uint64_t hash, void* value, const char** stored_key)
+{
+    return ht_probe_insert(table, key, length, hash, value, false, stored_key);
+}
+
+void* ht_upsert(ht* table, const char* key, void* value, const char** stored_key)
+{
+    size_t length = strlen(key);
+    return ht_upsert_hashed(table, key, length, ht_hash(key, length), value, stored_key);
+}
+
+const char* ht_set(ht* table, const char* key, void* value)
+{
+    const char* stored_key = NULL;
+    ht_upsert(table, key, value, &stored_key);
+    return stored_key;
+}
+
+void* ht_remove(ht* table, const char* key)
+{
+    size_t length = strlen(key);
+    size_t capacity = table->capacity;
+    size_t hole = ht_find_slot(table, key, length, ht_hash(key, length));
+    if (hole >= capacity) {
+        return NULL;
+    }
+    void* previous = table->entries[hole].value;
+
+    // Backward-shift deletion: pull following entries back so no probe
+    // sequence is broken, instead of leaving a tombstone.
+    size_t index = (hole + 1) & (capacity - 1);
+    while (table->entries[index].key != NULL) {
+        size_t distance = ht_distance(&table->entries[index], index, capacity);
+        if (table->layout == HT_ROBIN_HOOD) {
+            // Stop at an entry already in its home slot.
+            if (distance == 0) {
+                break;
+            }
+            table->entries[hole] = table->entries[index];
+            hole = index;
+        } else if (((index - hole) & (capacity - 1)) <= distance) {
+            // The entry's home is at or before the hole, so it may move there.
+            table->entries[hole] = table->entries[index];
+            hole = index;
+        }
+        index = (index + 1) & (capacity - 1);
+    }
+    table->entries[hole].key = NULL;
+    table->entries[hole].value = NULL;
+    table->length--;
+    return previous;
 }
 
 size_t ht_length(const ht* table)
@@ -186,6 +352,34 @@ size_t ht_length(const ht* table)
     return table->length;
 }
 
+void ht_get_stats(const ht* table, ht_stats* stats)
+{
+    stats->capacity = table->capacity;
+    stats->length = table->length;
+    stats->total_probes = 0;
+    stats->max_probes = 0;
+    for (size_t i = 0; i < table->capacity; i++) {
+        if (table->entries[i].key != NULL) {
+            size_t probes = ht_distance(&table->entries[i], i, table->capacity) + 1;
+            stats->total_probes += probes;
+            if (probes > stats->max_probes) {
+                stats->max_probes = probes;
+            }
+        }
+    }
+}
+
+void ht_probe_histogram(const ht* table, size_t histogram[], size_t length)
+{
+    memset(histogram, 0, length * sizeof(size_t));
+    for (size_t i = 0; i < table->capacity; i++) {
+        if (table->entries[i].key != NULL) {
+            size_t distance = ht_distance(&table->entries[i], i, table->capacity);
+            histogram[(distance < length) ? distance : length - 1]++;
+        }
+    }
+}
+
 hti ht_iterator(ht* table)
 {
     hti it;
@@ -5,29 +5,95 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 // Hash table structure: create with ht_create, free with ht_destroy.
 typedef struct ht ht;
 
+// Probing scheme of a hash table.
+typedef enum {
+    HT_LINEAR = 0,      // plain linear probing
+    HT_ROBIN_HOOD = 1   // linear probing keeping probe distances even
+} ht_layout;
+
+// Bounds and default of the maximum load, in percent of capacity.
+#define HT_MIN_LOAD 25
+#define HT_MAX_LOAD 95
+#define HT_DEFAULT_LOAD 75
+
 // Create hash table and return pointer to it, or NULL if out of memory.
+// Capacity is rounded up to a power of two; the table uses linear
+// probing and expands when three quarters full.
 ht* ht_create(size_t initialCapacity);
 
-// Free memory allocated for hash table, including allocated keys.
+// Create hash table with given probing scheme and maximum load, in
+// percent of capacity (HT_MIN_LOAD to HT_MAX_LOAD).
+ht* ht_create_with(size_t initialCapacity, ht_layout layout, unsigned max_load_percent);
+
+// Return capacity rounded up to the power of two the table will use.
+size_t ht_round_capacity(size_t capacity);
+
+// Free memory allocated for hash table, including the arena of copied keys.
 void ht_destroy(ht* table);
 
+// Return hash of the first length chars of key, as used by the table.
+uint64_t ht_hash(const char* key, size_t length);
+
 // Get item with given key (NUL-terminated) from hash table. Return
 // value (which was set with ht_set), or NULL if key not found.
 void* ht_get(const ht* table, const char* key);
 
+// Same as ht_get, for a key of given length (need not be NUL-terminated)
+// whose hash was already computed with ht_hash.
+void* ht_get_hashed(const ht* table, const char* key, size_t length, uint64_t hash);
+
 // Set item with given key (NUL-terminated) to value (which must not
-// be NULL). If not already present in table, key is copied to newly
-// allocated memory (keys are freed automatically when ht_destroy is
-// called). Return address of copied key, or NULL if out of memory.
+// be NULL). If not already present in table, key is copied once into
+// the table's key arena (freed in bulk when ht_destroy is called), so
+// the returned address stays valid and can be shared with the value.
+// Return address of copied key, or NULL if out of memory.
 const char* ht_set(ht* table, const char* key, void* value);
 
+// Set item like ht_set, with a single probe of the table. Return the
+// previous value for key, or NULL if key was not present. If stored_key
+// is not NULL, it receives the address of the table's copy of key.
+void* ht_upsert(ht* table, const char* key, void* value, const char** stored_key);
+
+// Same as ht_upsert, for a key of given length (need not be
+// NUL-terminated) whose hash was already computed with ht_hash.
+void* ht_upsert_hashed(ht* table, const char* key, size_t length, uint64_t hash, void* value, const char** stored_key);
+
+// Get item like ht_get_hashed, inserting key with value if not present,
+// with a single probe of the table. Return the value already set for key,
+// which is left unchanged, or NULL if value was inserted. If stored_key is
+// not NULL, it receives the address of the table's copy of key.
+void* ht_get_or_insert_hashed(ht* table, const char* key, size_t length, uint64_t hash, void* value, const char** stored_key);
+
+// Remove item with given key (NUL-terminated) and return its value, or
+// NULL if key not found. The key's copy stays in the arena until
+// ht_destroy. Don't call ht_remove during iteration.
+void* ht_remove(ht* table, const char* key);
+
 // Return number of items in hash table.
 size_t ht_length(const ht* table);
 
+// Probe statistics of a table, computed from where its entries sit, so
+// lookups and insertions pay nothing for them.
+typedef struct {
+    size_t capacity;      // number of slots
+    size_t length;        // number of items
+    size_t total_probes;  // slots examined to find every item once
+    size_t max_probes;    // slots examined to find the furthest item
+} ht_stats;
+
+// Fill stats for the current contents of table.
+void ht_get_stats(const ht* table, ht_stats* stats);
+
+// Count items by the slots examined to find them: histogram[i] receives the
+// items found after i + 1 probes, and the last of length counters also
+// receives every item further away. length must be at least 1.
+void ht_probe_histogram(const ht* table, size_t histogram[], size_t length);
+
 // Hash table iterator: create with ht_iterator, iterate with ht_next.
 typedef struct {
     const char* key;  // current key
@@ -0,0 +1,228 @@
+// Microbenchmark for ht.c: ht_set (with and without expansion), ht_get hits and
+// misses, and iteration, over SNES-like public symbol names, for both probing
+// schemes, several loads and several initial capacities. Prints ns/op and probe-length histograms.
+// Usage: htbench [capacity, default 32768] [repetitions, default 15]
+
+#include "ht.h"
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HISTOGRAM_LENGTH 9
+
+// Names match [A-Z][A-Z_0-9]+ like the publics ClassifySobjStrings finds: a
+// shared prefix, one or two underscore-separated parts, often a number.
+static const char* const prefixes[] = {
+    "PLAYER", "ENEMY", "SND", "SFX", "MUS", "GFX", "BG", "SPR", "OBJ", "MAP",
+    "TBL", "PAL", "DMA", "HDMA", "IRQ", "NMI", "VRAM", "OAM", "TXT", "LVL"
+};
+static const char* const parts[] = {
+    "X", "Y", "SPEED", "STATE", "INIT", "MAIN", "TILES", "PTR", "LEN", "BOSS",
+    "HIT", "ANIM", "FRAME", "BANK", "ADDR", "COUNT", "FLAGS", "LOOP", "END", "TMP"
+};
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t next_random(uint32_t bound)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (uint32_t)((rng_state * 2685821657736338717ULL) >> 32) % bound;
+}
+
+static double now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec * 1e9 + (double)now.tv_nsec;
+}
+
+// Fill names with count distinct names; duplicates are redrawn.
+static char** make_names(size_t count)
+{
+    char** names = calloc(count, sizeof(char*));
+    ht* seen = ht_create(count * 2);
+    if (names == NULL || seen == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(70);
+    }
+    char name[64];
+    for (size_t i = 0; i < count; ) {
+        int length = snprintf(name, sizeof(name), "%s_%s", prefixes[next_random(20)], parts[next_random(20)]);
+        if (next_random(3) == 0) {
+            length += snprintf(name + length, sizeof(name) - (size_t)length, "_%s", parts[next_random(20)]);
+        }
+        if (next_random(2) == 0) {
+            snprintf(name + length, sizeof(name) - (size_t)length, "%" PRIu32, next_random(1000));
+        }
+        const char* stored = NULL;
+        if (ht_get(seen, name) == NULL) {
+            stored = ht_set(seen, name, (void*)1);
+        }
+        if (stored != NULL) {
+            names[i] = malloc(strlen(name) + 1);
+            if (names[i] == NULL) {
+                fprintf(stderr, "out of memory\n");
+                exit(70);
+            }
+            strcpy(names[i], name);
+            i++;
+        }
+    }
+    ht_destroy(seen);
+    return names;
+}
+
+static void shuffle(char** names, size_t count)
+{
+    for (size_t i = count - 1; i > 0; i--) {
+        size_t j = next_random((uint32_t)i + 1);
+        char* swap = names[i];
+        names[i] = names[j];
+        names[j] = swap;
+    }
+}
+
+static double min_of(double a, double b)
+{
+    return (a < b) ? a : b;
+}
+
+// Fill a table of capacity slots to load percent, never expanding, then time
+// lookups of present and absent keys and one iteration. Print one row.
+static void run_lookups(ht_layout layout, size_t capacity, unsigned load, char** present,
+                        char** absent, int repetitions, uintptr_t* checksum)
+{
+    size_t count = capacity * load / 100;
+    double set = 1e300, hit = 1e300, miss = 1e300, iterate = 1e300;
+    size_t histogram[HISTOGRAM_LENGTH];
+    for (int rep = 0; rep < repetitions; rep++) {
+        ht* table = ht_create_with(capacity, layout, HT_MAX_LOAD);
+        double start = now_ns();
+        for (size_t i = 0; i < count; i++) {
+            ht_set(table, present[i], (void*)(uintptr_t)(i + 1));
+        }
+        set = min_of(set, (now_ns() - start) / (double)count);
+
+        // In another order than insertion, as when relocations are resolved
+        start = now_ns();
+        for (size_t i = count; i > 0; i--) {
+            *checksum += (uintptr_t)ht_get(table, present[(i * 7919) % count]);
+        }
+        hit = min_of(hit, (now_ns() - start) / (double)count);
+
+        start = now_ns();
+        for (size_t i = 0; i < count; i++) {
+            *checksum += (uintptr_t)ht_get(table, absent[i]);
+        }
+        miss = min_of(miss, (now_ns() - start) / (double)count);
+
+        start = now_ns();
+        hti it = ht_iterator(table);
+        while (ht_next(&it)) {
+            *checksum += (uintptr_t)it.value;
+        }
+        iterate = min_of(iterate, (now_ns() - start) / (double)count);
+
+        ht_probe_histogram(table, histogram, HISTOGRAM_LENGTH);
+        ht_destroy(table);
+    }
+    printf("%-11s %3u%% %8.1f %8.1f %8.1f %8.1f ",
+           (layout == HT_LINEAR) ? "linear" : "robin-hood", load, set, hit, miss, iterate);
+    for (int h = 0; h < HISTOGRAM_LENGTH; h++) {
+        printf(" %4.1f", 100.0 * (double)histogram[h] / (double)count);
+    }
+    printf("\n");
+}
+
+// Insert count keys into a table created with initial slots, at the default
+// maximum load, and return the best ns per ht_set; capacity receives the
+// final capacity.
+static double time_sets(ht_layout layout, size_t initial, char** present, size_t count,
+                        int repetitions, size_t* capacity)
+{
+    double best = 1e300;
+    for (int rep = 0; rep < repetitions; rep++) {
+        double start = now_ns();
+        ht* table = ht_create_with(initial, layout, HT_DEFAULT_LOAD);
+        for (size_t i = 0; i < count; i++) {
+            ht_set(table, present[i], (void*)(uintptr_t)(i + 1));
+        }
+        best = min_of(best, (now_ns() - start) / (double)count);
+        ht_stats stats;
+        ht_get_stats(table, &stats);
+        *capacity = stats.capacity;
+        ht_destroy(table);
+    }
+    return best;
+}
+
+// ht_expand is internal, so its cost is what growing from a smaller initial
+// capacity adds to the sets into a table created large enough.
+static void run_expansion(ht_layout layout, size_t capacity, char** present, int repetitions)
+{
+    size_t count = capacity * (HT_DEFAULT_LOAD - 5) / 100;
+    size_t final;
+    double sized = time_sets(layout, capacity, present, count, repetitions, &final);
+    static const size_t initials[] = { 16, 256, 4096 };
+    for (size_t i = 0; i < sizeof(initials) / sizeof(initials[0]); i++) {
+        if (initials[i] >= capacity) {
+            break;
+        }
+        double grown = time_sets(layout, initials[i], present, count, repetitions, &final);
+        unsigned expansions = 0;
+        for (size_t c = ht_round_capacity(initials[i]); c < final; c *= 2) {
+            expansions++;
+        }
+        printf("%-11s %8zu %8zu %10u %8.1f %8.1f %8.1f\n",
+               (layout == HT_LINEAR) ? "linear" : "robin-hood", initials[i], final,
+               expansions, grown, sized, grown - sized);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    size_t capacity = ht_round_capacity((argc > 1) ? (size_t)strtoul(argv[1], NULL, 10) : 32768);
+    int repetitions = (argc > 2) ? atoi(argv[2]) : 15;
+    if (capacity < 64 || repetitions < 1) {
+        fprintf(stderr, "usage: htbench [capacity >= 64] [repetitions >= 1]\n");
+        return 64;
+    }
+
+    // One draw, so present and absent names are distinct and alike.
+    char** names = make_names(capacity * 2);
+    shuffle(names, capacity * 2);
+    char** present = names;
+    char** absent = names + capacity;
+    uintptr_t checksum = 0;
+    static const unsigned loads[] = { 25, 50, 75, 90 };
+
+    printf("Lookups in %zu slots, best of %d runs, ns/op; %% of items found after 1..%d (last: more) probes\n",
+           capacity, repetitions, HISTOGRAM_LENGTH);
+    printf("%-11s %4s %8s %8s %8s %8s  %s\n", "layout", "load", "set", "get hit", "get miss", "iterate", "probes");
+    for (int layout = HT_LINEAR; layout <= HT_ROBIN_HOOD; layout++) {
+        for (size_t l = 0; l < sizeof(loads) / sizeof(loads[0]); l++) {
+            run_lookups((ht_layout)layout, capacity, loads[l], present, absent, repetitions, &checksum);
+        }
+    }
+
+    printf("\nExpansion to %zu slots at %d%% maximum load, ns/set\n", capacity, HT_DEFAULT_LOAD);
+    printf("%-11s %8s %8s %10s %8s %8s %8s\n", "layout", "initial", "final", "expansions", "grown", "presized", "expand");
+    for (int layout = HT_LINEAR; layout <= HT_ROBIN_HOOD; layout++) {
+        run_expansion((ht_layout)layout, capacity, present, repetitions);
+    }
+
+    // Printed so the lookups cannot be optimized away.
+    printf("checksum %" PRIxPTR "\n", checksum);
+
+    for (size_t i = 0; i < capacity * 2; i++) {
+        free(names[i]);
+    }
+    free(names);
+    return 0;
+}
@@ -0,0 +1,225 @@
+// ROM comparer for the differential link harness of ArgLink Re-Rewrite.
+// Compares a reference ROM with a candidate ROM byte by byte and reports the first
+// differing offsets, each with the section or relocation of the given SOB files that
+// wrote it last, as the linker applies all sections before any relocation.
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STRINGIZE_DETAIL(x) #x
+#define STRINGIZE(x) STRINGIZE_DETAIL(x)
+
+typedef struct ByteBuffer {
+	uint8_t* Bytes;
+	size_t Size;
+} ByteBuffer;
+
+// Where a ROM byte came from: section or relocation Index of File
+typedef struct Owner {
+	const char* File;
+	int32_t Index;
+	bool IsRelocation;
+	int32_t Start;
+	int32_t End;         // Exclusive
+	uint8_t Format;      // Relocations only
+	char Symbol[64];     // Relocations only
+} Owner;
+
+ByteBuffer ReadWholeFile(const char* path)
+{
+	ByteBuffer buffer;
+	memset(&buffer, 0, sizeof(buffer));
+	FILE* fileIn = fopen(path, "rb"); if (fileIn == NULL) { printf("RomDiff error: cannot open %s in Read mode, source code line " STRINGIZE(__LINE__) "\n", path); exit(66); }
+	fseek(fileIn, 0, SEEK_END);
+	long size = ftell(fileIn);
+	fseek(fileIn, 0, SEEK_SET);
+	if (size < 0) { printf("RomDiff error: cannot get the size of %s, source code line " STRINGIZE(__LINE__) "\n", path); exit(74); }
+	buffer.Size = (size_t)size;
+	buffer.Bytes = (uint8_t*)malloc(buffer.Size + 1); if (buffer.Bytes == NULL) { puts("RomDiff error: cannot allocate file bytes, source code line " STRINGIZE(__LINE__)); exit(70); }
+	if (fread(buffer.Bytes, 1, buffer.Size, fileIn) != buffer.Size) { printf("RomDiff error: reading %s failed, source code line " STRINGIZE(__LINE__) "\n", path); exit(74); }
+	fclose(fileIn);
+	return buffer;
+}
+
+typedef struct SobCursor {
+	const ByteBuffer* Sob;
+	size_t Position;
+	const char* Path;
+} SobCursor;
+
+uint8_t NextByte(SobCursor* cursor)
+{
+	if (cursor->Position >= cursor->Sob->Size) {
+		printf("RomDiff error: %s ends in the middle of a record, source code line " STRINGIZE(__LINE__) "\n", cursor->Path);
+		exit(65);
+	}
+	return cursor->Sob->Bytes[cursor->Position++];
+}
+
+int32_t NextLEInt32(SobCursor* cursor)
+{
+	uint32_t value = NextByte(cursor);
+	value |= (uint32_t)NextByte(cursor) << 8;
+	value |= (uint32_t)NextByte(cursor) << 16;
+	value |= (uint32_t)NextByte(cursor) << 24;
+	return (int32_t)value;
+}
+
+// Copy the name at the cursor into name, truncated to size, and skip its NUL
+void NextName(SobCursor* cursor, char* name, size_t size)
+{
+	size_t length = 0;
+	uint8_t c;
+	while ((c = NextByte(cursor)) != 0) {
+		if (length + 1 < size) {
+			name[length++] = (char)c;
+		}
+	}
+	name[length] = '\0';
+}
+
+bool Covers(const Owner* owner, int64_t offset)
+{
+	return (offset >= owner->Start) && (offset < owner->End);
+}
+
+// Walk sob like InputSobStepOne, InputSobStepTwo and PerformLink, and keep in sections and
+// relocations the last writer of offset seen so far.
+void FindOwners(const char* path, int64_t offset, Owner* section, Owner* relocation)
+{
+	ByteBuffer sob = ReadWholeFile(path);
+	SobCursor cursor = { &sob, 0, path };
+	if ((sob.Size < 8) || (memcmp(sob.Bytes, "SOBJ", 4) != 0)) {
+		free(sob.Bytes);
+		return;
+	}
+	cursor.Position = 6;
+	int32_t count = NextByte(&cursor);
+	NextByte(&cursor);
+
+	char name[64];
+	for (int32_t i = 0; i < count; i++) {
+		int32_t start = NextLEInt32(&cursor);
+		int32_t size = NextLEInt32(&cursor);
+		uint8_t type = NextByte(&cursor);
+		if (type == 0) {
+			cursor.Position += (size_t)size;
+		} else if (type == 1) {
+			NextByte(&cursor);
+			NextByte(&cursor);
+			NextName(&cursor, name, sizeof(name));
+		}
+		Owner candidate = { path, i, false, start, start + size, 0, "" };
+		if (Covers(&candidate, offset)) {
+			*section = candidate;
+		}
+	}
+
+	do {
+		NextName(&cursor, name, sizeof(name));
+		if (name[0] == '\0') {
+			break;
+		}
+		cursor.Position += 3;
+	} while (NextByte(&cursor) == 0);
+
+	for (int32_t r = 0; cursor.Position + 1 < sob.Size; r++) {
+		Owner candidate = { path, r, true, 0, 0, 0, "" };
+		NextName(&cursor, candidate.Symbol, sizeof(candidate.Symbol));
+		if (NextByte(&cursor) != 0) {
+			cursor.Position--;
+			NextName(&cursor, name, sizeof(name));
+			NextByte(&cursor);
+		}
+		cursor.Position += 8;
+		uint8_t check1 = NextByte(&cursor);
+		uint8_t check2 = NextByte(&cursor);
+		while ((check1 != 0) && (check2 != 0)) {
+			cursor.Position += 4;
+			check1 = NextByte(&cursor);
+			check2 = NextByte(&cursor);
+		}
+		int32_t patched = NextLEInt32(&cursor);
+		candidate.Format = NextByte(&cursor);
+		// Formats 0, 2 and 4 patch 1 to 3 bytes after the offset, 0x0E and 0x10 at it
+		static const int32_t skips[] = { 1, 1, 1, 0, 0 };
+		static const int32_t widths[] = { 1, 2, 3, 1, 2 };
+		static const uint8_t formats[] = { 0x00, 0x02, 0x04, 0x0E, 0x10 };
+		for (int f = 0; f < 5; f++) {
+			if (candidate.Format == formats[f]) {
+				candidate.Start = patched + skips[f];
+				candidate.End = candidate.Start + widths[f];
+			}
+		}
+		if (Covers(&candidate, offset)) {
+			*relocation = candidate;
+		}
+	}
+	free(sob.Bytes);
+}
+
+void ReportOwner(int64_t offset, char** sobs, int sobCount)
+{
+	Owner section, relocation;
+	memset(&section, 0, sizeof(section));
+	memset(&relocation, 0, sizeof(relocation));
+	for (int i = 0; i < sobCount; i++) {
+		FindOwners(sobs[i], offset, &section, &relocation);
+	}
+	if (relocation.File != NULL) {
+		printf("  relocation %" PRId32 " of %s, symbol %s, format %02X at %" PRIX32 "\n",
+			relocation.Index, relocation.File, relocation.Symbol, relocation.Format, relocation.Start);
+	}
+	if (section.File != NULL) {
+		printf("  %s section %" PRId32 " of %s, ROM offset %" PRIX32 " to %" PRIX32 "\n",
+			(relocation.File != NULL) ? "over" : "in", section.Index, section.File, section.Start, section.End - 1);
+	} else if (relocation.File == NULL) {
+		puts("  outside every section (fill byte)");
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t shown = 10;
+	int first = 1;
+	if ((argc > 1) && (strncmp(argv[1], "--max=", 6) == 0)) {
+		shown = (uint32_t)strtoul(argv[1] + 6, NULL, 10);
+		first = 2;
+	}
+	if (argc - first < 2) {
+		puts("Usage: romdiff [--max=10] <reference.rom> <candidate.rom> [obj1.sob obj2.sob ...]\n"
+			"Compares the ROMs and names the section or relocation behind the first differences.\n"
+			"Exits with 0 when the ROMs are identical, 1 when they differ.");
+		return 64;
+	}
+	ByteBuffer reference = ReadWholeFile(argv[first]);
+	ByteBuffer candidate = ReadWholeFile(argv[first + 1]);
+	char** sobs = argv + first + 2;
+	int sobCount = argc - first - 2;
+
+	size_t common = (reference.Size < candidate.Size) ? reference.Size : candidate.Size;
+	size_t differences = 0;
+	for (size_t i = 0; i < common; i++) {
+		if (reference.Bytes[i] != candidate.Bytes[i]) {
+			if (differences < shown) {
+				printf("%06zX: reference %02X, candidate %02X\n", i, reference.Bytes[i], candidate.Bytes[i]);
+				ReportOwner((int64_t)i, sobs, sobCount);
+			}
+			differences++;
+		}
+	}
+	if (reference.Size != candidate.Size) {
+		printf("Sizes differ: reference %zu bytes, candidate %zu bytes\n", reference.Size, candidate.Size);
+	}
+	if ((differences == 0) && (reference.Size == candidate.Size)) {
+		printf("ROMs are identical, %zu bytes\n", reference.Size);
+	} else {
+		printf("%zu of %zu common bytes differ\n", differences, common);
+	}
+	free(reference.Bytes);
+	free(candidate.Bytes);
+	return ((differences == 0) && (reference.Size == candidate.Size)) ? 0 : 1;
+}
@@ -0,0 +1,274 @@
+// Synthetic SOB corpus generator for ArgLink Re-Rewrite benchmarks.
+// Writes valid SOBJ files (sections, publics, relocations with expression terms) and
+// external files, then prints the object file names on one line for the linker's command line.
+// Every relocation refers to a public defined in the corpus, so the corpus links cleanly.
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STRINGIZE_DETAIL(x) #x
+#define STRINGIZE(x) STRINGIZE_DETAIL(x)
+
+typedef struct Settings {
+	uint32_t Objects;
+	uint32_t Sections;      // Per object, at most 255
+	uint32_t Externals;     // External files shared by type 1 sections, 0 for none
+	uint32_t ExternalShare; // Percent of sections that are external files
+	uint32_t SectionSize;   // Bytes of each data section
+	uint32_t Publics;       // Per object
+	uint32_t Relocations;   // Per object, at most one per 4 bytes of its sections
+	uint32_t Overlaps;      // Percent of relocations at any offset, so they may overlap others
+	uint32_t Terms;         // Most expression terms per relocation
+	uint32_t Depth;         // Most nesting deep of terms (0-7)
+	uint64_t Seed;
+	const char* Directory;
+} Settings;
+
+typedef struct ByteBuffer {
+	uint8_t* Bytes;
+	size_t Size;
+	size_t Capacity;
+} ByteBuffer;
+
+uint64_t s_random;
+
+// xorshift64*, so a seed gives the same corpus everywhere
+uint32_t NextRandom(uint32_t bound)
+{
+	s_random ^= s_random >> 12; s_random ^= s_random << 25; s_random ^= s_random >> 27;
+	return (bound > 0) ? (uint32_t)((s_random * 2685821657736338717ULL) >> 32) % bound : 0;
+}
+
+void PutBytes(ByteBuffer* buffer, const void* bytes, size_t count)
+{
+	if (buffer->Size + count > buffer->Capacity) {
+		buffer->Capacity = (buffer->Capacity > 0) ? buffer->Capacity * 2 : 65536;
+		if (buffer->Capacity < buffer->Size + count) {
+			buffer->Capacity = buffer->Size + count;
+		}
+		buffer->Bytes = (uint8_t*)realloc(buffer->Bytes, buffer->Capacity); if (buffer->Bytes == NULL) { puts("SobGen error: cannot grow buffer bytes, source code line " STRINGIZE(__LINE__)); exit(70); }
+	}
+	memcpy(buffer->Bytes + buffer->Size, bytes, count);
+	buffer->Size += count;
+}
+
+void PutByte(ByteBuffer* buffer, uint8_t value)
+{
+	PutBytes(buffer, &value, 1);
+}
+
+void PutLEInt32(ByteBuffer* buffer, int32_t value)
+{
+	uint8_t bytes[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+	PutBytes(buffer, bytes, 4);
+}
+
+void PutName(ByteBuffer* buffer, const char* name)
+{
+	PutBytes(buffer, name, strlen(name) + 1);
+}
+
+// Public names are unique across the corpus, with a prefix as in real projects
+void PublicName(char* name, size_t size, uint32_t object, uint32_t index)
+{
+	static const char* const prefixes[] = { "PLAYER", "ENEMY", "SND", "GFX", "BG", "TBL", "MAP" };
+	snprintf(name, size, "%s_%" PRIX32 "_%" PRIX32, prefixes[(object + index) % 7], object, index);
+}
+
+char* PathIn(const Settings* settings, const char* name)
+{
+	size_t length = strlen(settings->Directory) + strlen(name) + 2;
+	char* path = (char*)calloc(length, sizeof(char)); if (path == NULL) { puts("SobGen error: cannot allocate for path of type char*, source code line " STRINGIZE(__LINE__)); exit(70); }
+	snprintf(path, length, "%s/%s", settings->Directory, name);
+	return path;
+}
+
+void WriteFile(const char* path, const ByteBuffer* buffer)
+{
+	FILE* fileOut = fopen(path, "wb"); if (fileOut == NULL) { printf("SobGen error: cannot open %s in Write mode, source code line " STRINGIZE(__LINE__) "\n", path); exit(73); }
+	if (fwrite(buffer->Bytes, 1, buffer->Size, fileOut) != buffer->Size) { printf("SobGen error: writing %s failed, source code line " STRINGIZE(__LINE__) "\n", path); exit(74); }
+	fclose(fileOut);
+}
+
+// External files are sized like data sections, so both kinds weigh the same in a link
+void WriteExternals(const Settings* settings)
+{
+	ByteBuffer buffer;
+	memset(&buffer, 0, sizeof(buffer));
+	for (uint32_t e = 0; e < settings->Externals; e++) {
+		buffer.Size = 0;
+		for (uint32_t b = 0; b < settings->SectionSize; b++) {
+			PutByte(&buffer, (uint8_t)NextRandom(256));
+		}
+		char name[32];
+		snprintf(name, sizeof(name), "ext%" PRIu32 ".bin", e);
+		char* path = PathIn(settings, name);
+		WriteFile(path, &buffer);
+		free(path);
+	}
+	free(buffer.Bytes);
+}
+
+// Sections of all objects follow each other in the ROM, so nothing overlaps
+void WriteObject(const Settings* settings, uint32_t object, ByteBuffer* buffer)
+{
+	buffer->Size = 0;
+	PutBytes(buffer, "SOBJ", 4);
+	PutByte(buffer, 1); PutByte(buffer, 0);
+	PutByte(buffer, (uint8_t)settings->Sections); PutByte(buffer, 0);
+
+	uint32_t firstOffset = object * settings->Sections * settings->SectionSize;
+	for (uint32_t i = 0; i < settings->Sections; i++) {
+		PutLEInt32(buffer, (int32_t)(firstOffset + i * settings->SectionSize));
+		PutLEInt32(buffer, (int32_t)settings->SectionSize);
+		if ((settings->Externals > 0) && (NextRandom(100) < settings->ExternalShare)) {
+			char name[32];
+			snprintf(name, sizeof(name), "ext%" PRIu32 ".bin", NextRandom(settings->Externals));
+			char* path = PathIn(settings, name);
+			PutByte(buffer, 1);
+			PutByte(buffer, 0); PutByte(buffer, 0);
+			PutName(buffer, path);
+			free(path);
+		} else {
+			PutByte(buffer, 0);
+			for (uint32_t b = 0; b < settings->SectionSize; b++) {
+				PutByte(buffer, (uint8_t)NextRandom(256));
+			}
+		}
+	}
+
+	// Each public is followed by a zero byte to read on, and an empty name ends the list
+	char name[64];
+	for (uint32_t p = 0; p < settings->Publics; p++) {
+		PublicName(name, sizeof(name), object, p);
+		PutName(buffer, name);
+		uint32_t value = NextRandom(0x1000000);
+		PutByte(buffer, (uint8_t)value); PutByte(buffer, (uint8_t)(value >> 8)); PutByte(buffer, (uint8_t)(value >> 16));
+		PutByte(buffer, 0);
+	}
+	PutByte(buffer, 0);
+
+	// Every patch lies within the 4 bytes from its offset, so relocations get a 4-byte slot
+	// each, spread over the object's sections and in ROM order
+	uint32_t span = settings->Sections * settings->SectionSize;
+	uint32_t stride = (settings->Relocations > 0) ? (span / 4) / settings->Relocations : 0;
+	for (uint32_t r = 0; (r < settings->Relocations) && (settings->Publics > 0) && (span >= 4); r++) {
+		PublicName(name, sizeof(name), NextRandom(settings->Objects), NextRandom(settings->Publics));
+		PutName(buffer, name);
+		uint32_t termCount = NextRandom(settings->Terms + 1);
+		bool secondary = (termCount > 0) && (NextRandom(4) == 0);
+		if (secondary) {
+			PublicName(name, sizeof(name), NextRandom(settings->Objects), NextRandom(settings->Publics));
+			PutName(buffer, name);
+		}
+		PutByte(buffer, 0);
+		PutLEInt32(buffer, 0); PutLEInt32(buffer, 0);
+
+		// Check1 holds the deep (bits 4-6) and priority (bits 0-1); above 0x80 the term
+		// takes the value of the secondary symbol
+		static const uint8_t operations[] = { 0x0C, 0x0E, 0x10, 0x16, 0x02, 0x12 };
+		for (uint32_t t = 0; t < termCount; t++) {
+			uint8_t check1 = (uint8_t)((NextRandom(settings->Depth + 1) << 4) | NextRandom(4));
+			bool flagged = secondary && (NextRandom(3) == 0);
+			// Only the last term's own value is sure to be the right operand, so only it shifts
+			// or divides; a symbol value is never a shift count nor a divisor
+			uint8_t operation = operations[NextRandom(flagged ? 3 : ((t + 1 < termCount) ? 4 : 6))];
+			if (flagged) {
+				check1 |= (check1 == 0) ? 0x81 : 0x80;
+			} else if (check1 == 0) {
+				check1 = 1;
+			}
+			PutByte(buffer, check1);
+			PutByte(buffer, operation);
+			PutLEInt32(buffer, (int32_t)((operation == 0x02) ? NextRandom(16) : 1 + NextRandom(0x100)));
+		}
+		PutByte(buffer, 0); PutByte(buffer, 0);
+
+		// Formats 0, 2 and 4 patch from the byte after the offset
+		static const uint8_t formats[] = { 0x00, 0x02, 0x04, 0x0E, 0x10 };
+		uint8_t format = formats[NextRandom(5)];
+		uint32_t offset = 4 * (r * stride + NextRandom(stride));
+		if (NextRandom(100) < settings->Overlaps) {
+			offset = NextRandom(span - 3);
+		}
+		PutLEInt32(buffer, (int32_t)(firstOffset + offset));
+		PutByte(buffer, format);
+	}
+	PutByte(buffer, 0);
+}
+
+bool IsNumberOption(const char* name, const char* argument, uint32_t* value)
+{
+	size_t length = strlen(name);
+	if ((strncmp(argument, "--", 2) != 0) || (strncmp(argument + 2, name, length) != 0) || (argument[2 + length] != '=')) {
+		return false;
+	}
+	char* end;
+	unsigned long parsed = strtoul(argument + 3 + length, &end, 10);
+	if ((*end != '\0') || (parsed > UINT32_MAX)) {
+		printf("SobGen error: option --%s needs a number.\n", name);
+		exit(64);
+	}
+	*value = (uint32_t)parsed;
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	Settings settings = { 100, 4, 8, 25, 1024, 50, 200, 0, 4, 3, 1, "." };
+	for (int i = 1; i < argc; i++) {
+		uint32_t seed = 0;
+		if (IsNumberOption("objects", argv[i], &settings.Objects) || IsNumberOption("sections", argv[i], &settings.Sections) ||
+			IsNumberOption("externals", argv[i], &settings.Externals) || IsNumberOption("external-share", argv[i], &settings.ExternalShare) ||
+			IsNumberOption("section-size", argv[i], &settings.SectionSize) || IsNumberOption("publics", argv[i], &settings.Publics) ||
+			IsNumberOption("relocations", argv[i], &settings.Relocations) || IsNumberOption("overlaps", argv[i], &settings.Overlaps) ||
+			IsNumberOption("terms", argv[i], &settings.Terms) ||
+			IsNumberOption("depth", argv[i], &settings.Depth)) {
+			continue;
+		} else if (IsNumberOption("seed", argv[i], &seed)) {
+			settings.Seed = seed;
+		} else if (strncmp(argv[i], "--dir=", 6) == 0) {
+			settings.Directory = argv[i] + 6;
+		} else {
+			puts("Usage: sobgen [--objects=100] [--sections=4] [--externals=8] [--external-share=25]\n"
+				"              [--section-size=1024] [--publics=50] [--relocations=200] [--overlaps=0]\n"
+				"              [--terms=4] [--depth=3] [--seed=1] [--dir=.]\n"
+				"Writes obj<n>.sob and ext<n>.bin files to the directory, then prints the object names.\n"
+				"Relocations patch distinct bytes, except the --overlaps percent placed anywhere.");
+			return 64;
+		}
+	}
+	if ((settings.Sections > 255) || (settings.Depth > 7) || (settings.ExternalShare > 100) || (settings.SectionSize < 4) || (settings.Objects < 1) ||
+		(settings.Overlaps > 100)) {
+		puts("SobGen error: sections go up to 255, depth up to 7, external share and overlaps up to 100, section size from 4, objects from 1.");
+		return 64;
+	}
+	if ((settings.Publics > 0) && ((uint64_t)settings.Relocations * 4 > (uint64_t)settings.Sections * settings.SectionSize)) {
+		puts("SobGen error: relocations go up to one per 4 bytes of sections.");
+		return 64;
+	}
+	if ((uint64_t)settings.Objects * settings.Sections * settings.SectionSize > 0x7FFFFFFF) {
+		puts("SobGen error: the sections do not fit in a ROM.");
+		return 64;
+	}
+	s_random = (settings.Seed * 0x9E3779B97F4A7C15ULL) | 1;
+
+	WriteExternals(&settings);
+	ByteBuffer buffer;
+	memset(&buffer, 0, sizeof(buffer));
+	for (uint32_t o = 0; o < settings.Objects; o++) {
+		WriteObject(&settings, o, &buffer);
+		char name[32];
+		snprintf(name, sizeof(name), "obj%" PRIu32 ".sob", o);
+		char* path = PathIn(&settings, name);
+		WriteFile(path, &buffer);
+		printf("%s%s", (o > 0) ? " " : "", path);
+		free(path);
+	}
+	putchar('\n');
+	free(buffer.Bytes);
+	return 0;
+}